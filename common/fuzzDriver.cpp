@@ -0,0 +1,201 @@
+#include "fuzzDriver.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> PacketData;
+
+static bool read_packet(const std::filesystem::path &path, std::vector<PacketData> &corpus)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Файлы и каталоги (без вложенных) в порядке имен, чтобы прогоны повторялись
+static bool load_corpus(const std::vector<const char*> &paths, std::vector<PacketData> &corpus)
+{
+  for (const char *path : paths)
+  {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec))
+    {
+      if (!read_packet(path, corpus))
+      {
+        printf("Cannot read %s\n", path);
+        return false;
+      }
+      continue;
+    }
+    std::vector<std::filesystem::path> files;
+    for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+      if (entry.is_regular_file())
+        files.push_back(entry.path());
+    std::sort(files.begin(), files.end());
+    for (const auto &file : files)
+      if (!read_packet(file, corpus))
+      {
+        printf("Cannot read %s\n", file.string().c_str());
+        return false;
+      }
+  }
+  return true;
+}
+
+// Копия ровно нужного размера: чтение за концом пакета AddressSanitizer поймает сразу, а не в чужих данных.
+// У пустого пакета нет даже типа, а libFuzzer всегда начинает с пустого входа
+static void run_packet(const uint8_t *data, size_t size)
+{
+  if (size == 0)
+    return;
+  PacketData buffer(data, data + size);
+  ENetPacket packet = {};
+  packet.data = buffer.data();
+  packet.dataLength = buffer.size();
+  fuzz_deserialize(&packet);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  run_packet(data, size);
+  return 0;
+}
+
+// Каждый тип отдельно: пакеты корпуса этого типа разбираются по кругу, пока не пройдет seconds.
+// Пакеты не копируются, deserialize_* не меняют их (кроме расшифровки с верным тегом, которой в корпусе нет)
+static void bench(std::vector<PacketData> &corpus, double seconds)
+{
+  std::vector<ENetPacket> byType[256];
+  for (PacketData &data : corpus)
+    if (!data.empty())
+    {
+      ENetPacket packet = {};
+      packet.data = data.data();
+      packet.dataLength = data.size();
+      byType[data[0]].push_back(packet);
+    }
+
+  printf("%-24s %8s %12s %10s\n", "message", "packets", "Mmsg/s", "MB/s");
+  for (int type = 0; type < 256; ++type)
+  {
+    std::vector<ENetPacket> &packets = byType[type];
+    if (packets.empty())
+      continue;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do
+    {
+      // время проверяется раз в несколько тысяч сообщений, чтобы не мерить часы
+      for (size_t pass = 0; pass * packets.size() < 4096; ++pass)
+        for (ENetPacket &packet : packets)
+        {
+          fuzz_deserialize(&packet);
+          ++messages;
+          bytes += packet.dataLength;
+        }
+      elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < seconds);
+
+    const char *name = message_type_name(uint8_t(type));
+    std::string label = name ? name : "type " + std::to_string(type);
+    printf("%-24s %8zu %12.2f %10.0f\n", label.c_str(), packets.size(), messages / elapsed * 1e-6,
+           bytes / elapsed / (1024.0 * 1024.0));
+  }
+}
+
+// libFuzzer зовет до разбора своих флагов: --bench перехватывается здесь, чтобы режим был в обеих сборках
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+  bool benchMode = false;
+  double seconds = 1.0;
+  std::vector<const char*> paths;
+  for (int i = 1; i < *argc; ++i)
+  {
+    const char *arg = (*argv)[i];
+    if (strcmp(arg, "--bench") == 0)
+      benchMode = true;
+    else if (strcmp(arg, "--seconds") == 0 && i + 1 < *argc)
+      seconds = std::max(atof((*argv)[++i]), 0.01);
+    else if (arg[0] != '-')
+      paths.push_back(arg);
+  }
+  if (!benchMode)
+    return 0;
+
+  std::vector<PacketData> corpus;
+  if (!load_corpus(paths, corpus))
+    exit(1);
+  if (corpus.empty())
+  {
+    printf("Usage: %s --bench <corpus> [--seconds S]\n", (*argv)[0]);
+    exit(1);
+  }
+  bench(corpus, seconds);
+  exit(0);
+}
+
+#if !FUZZ_WITH_LIBFUZZER
+// Порча как у fuzz_packet_data в w10: несколько случайных байтов, иногда еще и другая длина
+static void mutate(PacketData &data, std::mt19937 &rng)
+{
+  if (rng() % 4 == 0)
+    data.resize(rng() % (data.size() + 8));
+  if (data.empty())
+    return;
+  const uint32_t flips = 1 + rng() % 4;
+  for (uint32_t i = 0; i < flips; ++i)
+    data[rng() % data.size()] = uint8_t(rng());
+}
+
+int main(int argc, char **argv)
+{
+  LLVMFuzzerInitialize(&argc, &argv);
+
+  uint64_t mutations = 0;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--mutate") == 0 && i + 1 < argc)
+      mutations = strtoull(argv[++i], nullptr, 10);
+    else
+      paths.push_back(argv[i]);
+  }
+  std::vector<PacketData> corpus;
+  if (paths.empty() || !load_corpus(paths, corpus))
+  {
+    printf("Usage: %s [--mutate N] <corpus files or directories>\n", argv[0]);
+    printf("       %s --bench <corpus> [--seconds S]\n", argv[0]);
+    return 1;
+  }
+
+  for (const PacketData &data : corpus)
+    run_packet(data.data(), data.size());
+  printf("Ran %zu packets\n", corpus.size());
+  if (mutations == 0 || corpus.empty())
+    return 0;
+
+  // зерно постоянное: тот же запуск повторит найденное падение
+  std::mt19937 rng(12345);
+  PacketData data;
+  for (uint64_t i = 0; i < mutations; ++i)
+  {
+    data = corpus[rng() % corpus.size()];
+    mutate(data, rng);
+    run_packet(data.data(), data.size());
+  }
+  printf("Ran %llu mutated packets\n", (unsigned long long)mutations);
+  return 0;
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <enet/enet.h>
+#include <cstddef>
+#include <cstdint>
+
+// Fuzz-цель недели: все deserialize_* протокола за одной точкой входа, совместимой с libFuzzer.
+// Вход - пакет целиком, с типом в первом байте, поэтому корпусом служат пакеты, записанные
+// с --capture-packets (packetCapture.h).
+// С ENABLE_FUZZING (clang) main дает libFuzzer:
+//   wN_fuzz <корпус>                   - фаззинг с обратной связью по покрытию, под AddressSanitizer
+//   wN_fuzz <файл>                     - воспроизвести найденное падение
+// Без опции у цели свой main, без покрытия:
+//   wN_fuzz <файлы или каталоги>       - прогнать пакеты через разбор
+//   wN_fuzz --mutate N <корпус>        - N пакетов корпуса с испорченными случайными байтами
+// В обеих сборках:
+//   wN_fuzz --bench <корпус> [--seconds S] - сообщений в секунду для каждого типа, S секунд на тип (по умолчанию 1)
+
+// Драйвер общий, а эти две функции свои у каждой недели.
+// Разбирает пакет так же, как получатель: по типу соответствующим deserialize_*. Пустых пакетов драйвер не передает.
+// Определяется в fuzzHarness.cpp недели
+void fuzz_deserialize(ENetPacket *packet);
+// Имя типа для вывода --bench, nullptr для неизвестного. Определяется в protocol.cpp недели
+const char *message_type_name(uint8_t type);
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <enet/enet.h>
+#include "netStats.h"
+#include "packetCapture.h"
+
+// Отправка пакета протокола любой недели: пакет попадает в счетчики трафика (netStats.h) и в запись корпуса (packetCapture.h)
+inline void net_send_packet(ENetPeer *peer, uint8_t channel, ENetPacket *packet)
+{
+  net_stats_packet(E_NET_STATS_SENT, peer, packet);
+  packet_capture(packet);
+  enet_peer_send(peer, channel, packet);
+}
@@ -0,0 +1,320 @@
+#include "netStats.h"
+#include <cstdlib>
+#include <cstring>
+
+#if NET_STATS
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+struct NetStatsAtomicCounters
+{
+  std::atomic<uint64_t> packets;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> reliable;
+  std::atomic<uint64_t> unsequenced;
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> nanoseconds;
+};
+
+// Счетчики пиров выделяются блоками при первом пакете пира из блока: память растет с числом пиров,
+// а не с пределом ENet. Блок пишет только поток корзины, сводящий поток видит его после release-записи указателя
+constexpr size_t NET_STATS_PEER_CHUNK = 64;
+constexpr size_t NET_STATS_PEER_CHUNKS = (NET_STATS_PEERS + NET_STATS_PEER_CHUNK - 1) / NET_STATS_PEER_CHUNK;
+
+struct NetStatsBucket
+{
+  NetStatsAtomicCounters types[E_NET_STATS_DIRECTION_COUNT][NET_STATS_TYPES];
+  std::atomic<NetStatsAtomicCounters*> peerChunks[E_NET_STATS_DIRECTION_COUNT][NET_STATS_PEER_CHUNKS];
+};
+
+// Корзины не освобождаются: счет завершившегося потока остается в сумме.
+// Список живет до конца процесса, чтобы поток, отправляющий пакет при выходе, не нашел его разрушенным
+static std::mutex &buckets_mutex()
+{
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+static std::vector<NetStatsBucket*> &all_buckets()
+{
+  static std::vector<NetStatsBucket*> *buckets = new std::vector<NetStatsBucket*>();
+  return *buckets;
+}
+
+static NetStatsBucket &thread_bucket()
+{
+  thread_local NetStatsBucket *bucket = nullptr;
+  if (!bucket)
+  {
+    bucket = new NetStatsBucket();
+    std::lock_guard<std::mutex> lock(buckets_mutex());
+    all_buckets().push_back(bucket);
+  }
+  return *bucket;
+}
+
+// Писатель у корзины один, поэтому вместо атомарного сложения отдельные load и store: это обычный add без lock,
+// а сводящий поток все равно видит целые значения
+static void add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static NetStatsAtomicCounters &peer_counters(NetStatsBucket &bucket, NetStatsDirection direction, size_t peer)
+{
+  std::atomic<NetStatsAtomicCounters*> &chunk = bucket.peerChunks[direction][peer / NET_STATS_PEER_CHUNK];
+  NetStatsAtomicCounters *counters = chunk.load(std::memory_order_relaxed);
+  if (!counters)
+  {
+    counters = new NetStatsAtomicCounters[NET_STATS_PEER_CHUNK]();
+    chunk.store(counters, std::memory_order_release);
+  }
+  return counters[peer % NET_STATS_PEER_CHUNK];
+}
+
+static void add_packet(NetStatsAtomicCounters &counters, const ENetPacket *packet)
+{
+  add(counters.packets, 1);
+  add(counters.bytes, packet->dataLength);
+  add(counters.reliable, (packet->flags & ENET_PACKET_FLAG_RELIABLE) ? 1 : 0);
+  add(counters.unsequenced, (packet->flags & ENET_PACKET_FLAG_UNSEQUENCED) ? 1 : 0);
+}
+
+void net_stats_packet(NetStatsDirection direction, const ENetPeer *peer, const ENetPacket *packet)
+{
+  if (packet->dataLength == 0)
+    return;
+  NetStatsBucket &bucket = thread_bucket();
+  add_packet(bucket.types[direction][packet->data[0]], packet);
+  if (peer)
+  {
+    const size_t peerIndex = peer->incomingPeerID < NET_STATS_PEERS ? peer->incomingPeerID : NET_STATS_PEERS - 1;
+    add_packet(peer_counters(bucket, direction, peerIndex), packet);
+  }
+}
+
+void net_stats_time(NetStatsDirection direction, uint8_t type, uint64_t nanoseconds)
+{
+  NetStatsAtomicCounters &counters = thread_bucket().types[direction][type];
+  add(counters.calls, 1);
+  add(counters.nanoseconds, nanoseconds);
+}
+
+uint64_t net_stats_now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void sum_counters(NetStatsCounters &sum, const NetStatsAtomicCounters &counters)
+{
+  sum.packets += counters.packets.load(std::memory_order_relaxed);
+  sum.bytes += counters.bytes.load(std::memory_order_relaxed);
+  sum.reliable += counters.reliable.load(std::memory_order_relaxed);
+  sum.unsequenced += counters.unsequenced.load(std::memory_order_relaxed);
+  sum.calls += counters.calls.load(std::memory_order_relaxed);
+  sum.nanoseconds += counters.nanoseconds.load(std::memory_order_relaxed);
+}
+#endif
+
+void net_stats_collect(NetStats &stats)
+{
+  stats = NetStats();
+#if NET_STATS
+  std::lock_guard<std::mutex> lock(buckets_mutex());
+  for (const NetStatsBucket *bucket : all_buckets())
+    for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+    {
+      for (size_t t = 0; t < NET_STATS_TYPES; ++t)
+        sum_counters(stats.types[d][t], bucket->types[d][t]);
+      for (size_t c = 0; c < NET_STATS_PEER_CHUNKS; ++c)
+      {
+        const NetStatsAtomicCounters *counters = bucket->peerChunks[d][c].load(std::memory_order_acquire);
+        if (!counters)
+          continue;
+        std::vector<NetStatsCounters> &peers = stats.peers[d];
+        if (peers.size() < (c + 1) * NET_STATS_PEER_CHUNK)
+          peers.resize((c + 1) * NET_STATS_PEER_CHUNK);
+        for (size_t p = 0; p < NET_STATS_PEER_CHUNK; ++p)
+          sum_counters(peers[c * NET_STATS_PEER_CHUNK + p], counters[p]);
+      }
+    }
+#endif
+}
+
+static NetStatsCounters diff_counters(const NetStatsCounters &cur, const NetStatsCounters &prev)
+{
+  NetStatsCounters diff;
+  diff.packets = cur.packets - prev.packets;
+  diff.bytes = cur.bytes - prev.bytes;
+  diff.reliable = cur.reliable - prev.reliable;
+  diff.unsequenced = cur.unsequenced - prev.unsequenced;
+  diff.calls = cur.calls - prev.calls;
+  diff.nanoseconds = cur.nanoseconds - prev.nanoseconds;
+  return diff;
+}
+
+void net_stats_diff(const NetStats &cur, const NetStats &prev, NetStats &diff)
+{
+  for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+  {
+    for (size_t t = 0; t < NET_STATS_TYPES; ++t)
+      diff.types[d][t] = diff_counters(cur.types[d][t], prev.types[d][t]);
+    // пиры, появившиеся после prev, считаются с нуля
+    const NetStatsCounters zero;
+    diff.peers[d].resize(cur.peers[d].size());
+    for (size_t p = 0; p < cur.peers[d].size(); ++p)
+      diff.peers[d][p] = diff_counters(cur.peers[d][p], p < prev.peers[d].size() ? prev.peers[d][p] : zero);
+  }
+}
+
+static const char *DIRECTION_NAMES[E_NET_STATS_DIRECTION_COUNT] = {"sent", "recv"};
+
+static const char *type_name(NetStatsTypeName typeName, size_t type, char (&buffer)[16])
+{
+  const char *name = typeName ? typeName(static_cast<uint8_t>(type)) : nullptr;
+  if (name)
+    return name;
+  snprintf(buffer, sizeof(buffer), "type%zu", type);
+  return buffer;
+}
+
+void net_stats_print_table(FILE *f, const NetStats &stats, double seconds, NetStatsTypeName typeName)
+{
+  const double perSecond = seconds > 0.0 ? 1.0 / seconds : 0.0;
+  fprintf(f, "net stats for %.1f s\n", seconds);
+  fprintf(f, "%-4s %-24s %10s %10s %8s %6s %6s %10s\n",
+          "dir", "type", "pkts/s", "bytes/s", "avgSize", "rel%", "unseq%", "ns/call");
+  for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+    for (size_t t = 0; t < NET_STATS_TYPES; ++t)
+    {
+      const NetStatsCounters &c = stats.types[d][t];
+      if (c.packets == 0 && c.calls == 0)
+        continue;
+      char buffer[16];
+      fprintf(f, "%-4s %-24s %10.1f %10.0f %8.1f %6.1f %6.1f %10.0f\n", DIRECTION_NAMES[d], type_name(typeName, t, buffer),
+              c.packets * perSecond, c.bytes * perSecond,
+              c.packets > 0 ? double(c.bytes) / c.packets : 0.0,
+              c.packets > 0 ? 100.0 * c.reliable / c.packets : 0.0,
+              c.packets > 0 ? 100.0 * c.unsequenced / c.packets : 0.0,
+              c.calls > 0 ? double(c.nanoseconds) / c.calls : 0.0);
+    }
+  fprintf(f, "%-4s %-6s %10s %10s\n", "dir", "peer", "pkts/s", "bytes/s");
+  for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+    for (size_t p = 0; p < stats.peers[d].size(); ++p)
+    {
+      const NetStatsCounters &c = stats.peers[d][p];
+      if (c.packets > 0)
+        fprintf(f, "%-4s %-6zu %10.1f %10.0f\n", DIRECTION_NAMES[d], p, c.packets * perSecond, c.bytes * perSecond);
+    }
+}
+
+void net_stats_write_json(FILE *f, const NetStats &stats, double seconds, NetStatsTypeName typeName)
+{
+  fprintf(f, "{\"seconds\":%.3f,\"types\":[", seconds);
+  bool first = true;
+  for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+    for (size_t t = 0; t < NET_STATS_TYPES; ++t)
+    {
+      const NetStatsCounters &c = stats.types[d][t];
+      if (c.packets == 0 && c.calls == 0)
+        continue;
+      char buffer[16];
+      fprintf(f, "%s{\"dir\":\"%s\",\"type\":\"%s\",\"id\":%zu,\"packets\":%llu,\"bytes\":%llu,\"reliable\":%llu,"
+                 "\"unsequenced\":%llu,\"calls\":%llu,\"ns\":%llu}",
+              first ? "" : ",", DIRECTION_NAMES[d], type_name(typeName, t, buffer), t,
+              (unsigned long long)c.packets, (unsigned long long)c.bytes, (unsigned long long)c.reliable,
+              (unsigned long long)c.unsequenced, (unsigned long long)c.calls, (unsigned long long)c.nanoseconds);
+      first = false;
+    }
+  fprintf(f, "],\"peers\":[");
+  first = true;
+  for (int d = 0; d < E_NET_STATS_DIRECTION_COUNT; ++d)
+    for (size_t p = 0; p < stats.peers[d].size(); ++p)
+    {
+      const NetStatsCounters &c = stats.peers[d][p];
+      if (c.packets == 0)
+        continue;
+      fprintf(f, "%s{\"dir\":\"%s\",\"peer\":%zu,\"packets\":%llu,\"bytes\":%llu,\"reliable\":%llu,\"unsequenced\":%llu}",
+              first ? "" : ",", DIRECTION_NAMES[d], p, (unsigned long long)c.packets, (unsigned long long)c.bytes,
+              (unsigned long long)c.reliable, (unsigned long long)c.unsequenced);
+      first = false;
+    }
+  fprintf(f, "]}\n");
+}
+
+NetStatsReporter::~NetStatsReporter()
+{
+  if (m_json)
+    fclose(m_json);
+}
+
+bool NetStatsReporter::open(uint32_t intervalMs, const char *jsonPath)
+{
+#if !NET_STATS
+  printf("Net stats are compiled out, build with ENABLE_NET_STATS\n");
+  (void)intervalMs;
+  (void)jsonPath;
+  return true;
+#else
+  if (jsonPath)
+  {
+    m_json = fopen(jsonPath, "a");
+    if (!m_json)
+      return false;
+  }
+  m_intervalMs = intervalMs;
+  return true;
+#endif
+}
+
+bool NetStatsReporter::openFromArgs(int argc, const char **argv)
+{
+  double seconds = 0.0;
+  const char *jsonPath = nullptr;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--net-stats") == 0)
+      seconds = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--net-stats-json") == 0)
+      jsonPath = argv[i + 1];
+  }
+  if (jsonPath && seconds <= 0.0)
+    seconds = 1.0;
+  if (seconds <= 0.0)
+    return true;
+  if (!open(static_cast<uint32_t>(seconds * 1000.0), jsonPath))
+  {
+    printf("Cannot open net stats output %s\n", jsonPath);
+    return false;
+  }
+  return true;
+}
+
+void NetStatsReporter::update(uint32_t curTime)
+{
+  if (m_intervalMs == 0)
+    return;
+  if (!m_started)
+  {
+    net_stats_collect(m_last);
+    m_lastTime = curTime;
+    m_started = true;
+    return;
+  }
+  if (curTime - m_lastTime < m_intervalMs)
+    return;
+  net_stats_collect(m_current);
+  net_stats_diff(m_current, m_last, m_diff);
+  const double seconds = (curTime - m_lastTime) * 0.001;
+  if (m_json)
+  {
+    net_stats_write_json(m_json, m_diff, seconds, m_typeName);
+    fflush(m_json);
+  }
+  else
+    net_stats_print_table(stdout, m_diff, seconds, m_typeName);
+  m_last = m_current;
+  m_lastTime = curTime;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <enet/enet.h>
+
+// Счетчики трафика по типам сообщений и по пирам: пакеты, байты полезного груза (без заголовков ENet и UDP),
+// надежные и ненадежные пакеты, время send_*/deserialize_*.
+// Каждый поток пишет в свою корзину без блокировок, net_stats_collect сводит корзины всех потоков.
+// Собирается с NET_STATS=1 (опция ENABLE_NET_STATS), иначе все вызовы пустые и вырезаются компилятором
+
+#ifndef NET_STATS
+#define NET_STATS 0
+#endif
+
+enum NetStatsDirection : uint8_t
+{
+  E_NET_STATS_SENT = 0,
+  E_NET_STATS_RECEIVED,
+  E_NET_STATS_DIRECTION_COUNT
+};
+
+constexpr size_t NET_STATS_TYPES = 256; // по первому байту пакета
+constexpr size_t NET_STATS_PEERS = size_t(ENET_PROTOCOL_MAXIMUM_PEER_ID) + 1; // по incomingPeerID, все, что допускает ENet
+
+struct NetStatsCounters
+{
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  uint64_t reliable = 0;
+  uint64_t unsequenced = 0;
+  uint64_t calls = 0;       // замеров времени сериализации
+  uint64_t nanoseconds = 0;
+};
+
+struct NetStats
+{
+  NetStatsCounters types[E_NET_STATS_DIRECTION_COUNT][NET_STATS_TYPES];
+  // индекс - incomingPeerID; длина - до последнего пира, у которого был трафик, с округлением вверх
+  std::vector<NetStatsCounters> peers[E_NET_STATS_DIRECTION_COUNT];
+};
+
+// Имя типа сообщения для вывода, nullptr для неизвестных
+typedef const char *(*NetStatsTypeName)(uint8_t type);
+
+#if NET_STATS
+void net_stats_packet(NetStatsDirection direction, const ENetPeer *peer, const ENetPacket *packet);
+void net_stats_time(NetStatsDirection direction, uint8_t type, uint64_t nanoseconds);
+uint64_t net_stats_now();
+#else
+inline void net_stats_packet(NetStatsDirection, const ENetPeer*, const ENetPacket*) {}
+inline void net_stats_time(NetStatsDirection, uint8_t, uint64_t) {}
+#endif
+
+// Сумма корзин всех потоков с начала работы
+void net_stats_collect(NetStats &stats);
+void net_stats_diff(const NetStats &cur, const NetStats &prev, NetStats &diff);
+// Значения в секунду за seconds секунд
+void net_stats_print_table(FILE *f, const NetStats &stats, double seconds, NetStatsTypeName typeName);
+// Одна строка JSON со счетчиками как есть
+void net_stats_write_json(FILE *f, const NetStats &stats, double seconds, NetStatsTypeName typeName);
+
+// Замер времени сериализации сообщения type от создания до конца области видимости
+class NetStatsTimer
+{
+ public:
+#if NET_STATS
+    NetStatsTimer(NetStatsDirection direction, uint8_t type)
+      : m_start(net_stats_now()), m_direction(direction), m_type(type) {}
+    ~NetStatsTimer() { net_stats_time(m_direction, m_type, net_stats_now() - m_start); }
+#else
+    NetStatsTimer(NetStatsDirection, uint8_t) {}
+#endif
+    NetStatsTimer(const NetStatsTimer&) = delete;
+    NetStatsTimer& operator=(const NetStatsTimer&) = delete;
+
+#if NET_STATS
+ private:
+    uint64_t m_start;
+    NetStatsDirection m_direction;
+    uint8_t m_type;
+#endif
+};
+
+// Периодический вывод: раз в интервал сводит корзины и выводит разницу с прошлым выводом
+// таблицей в stdout или строкой JSON в файл
+class NetStatsReporter
+{
+ public:
+    explicit NetStatsReporter(NetStatsTypeName typeName) : m_typeName(typeName) {}
+    ~NetStatsReporter();
+    NetStatsReporter(const NetStatsReporter&) = delete;
+    NetStatsReporter& operator=(const NetStatsReporter&) = delete;
+
+    // intervalMs 0 - не выводить. jsonPath не nullptr - дописывать в файл вместо таблицы
+    bool open(uint32_t intervalMs, const char *jsonPath);
+    // --net-stats <seconds> и --net-stats-json <file> из командной строки, без них вывода нет
+    bool openFromArgs(int argc, const char **argv);
+    void update(uint32_t curTime);
+
+ private:
+    NetStatsTypeName m_typeName;
+    uint32_t m_intervalMs = 0;
+    uint32_t m_lastTime = 0;
+    bool m_started = false;
+    FILE *m_json = nullptr;
+    NetStats m_last;
+    NetStats m_current;
+    NetStats m_diff;
+};
@@ -0,0 +1,66 @@
+#include "packetCapture.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+static std::atomic<bool> captureEnabled = false;
+static std::mutex captureMutex;
+static std::string captureDir;
+static PacketCaptureTypeName captureTypeName = nullptr;
+static uint32_t captureCounts[256] = {};
+
+bool packet_capture_open(const char *dir, PacketCaptureTypeName typeName)
+{
+  std::lock_guard<std::mutex> lock(captureMutex);
+  // проверяем, что в каталог можно писать, до первого пакета
+  const std::string probe = std::string(dir) + "/.capture";
+  FILE *f = fopen(probe.c_str(), "wb");
+  if (!f)
+    return false;
+  fclose(f);
+  remove(probe.c_str());
+  captureDir = dir;
+  captureTypeName = typeName;
+  memset(captureCounts, 0, sizeof(captureCounts));
+  captureEnabled.store(true, std::memory_order_release);
+  return true;
+}
+
+bool packet_capture_open_from_args(int argc, const char **argv, PacketCaptureTypeName typeName)
+{
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "--capture-packets") == 0)
+    {
+      if (!packet_capture_open(argv[i + 1], typeName))
+      {
+        printf("Cannot capture packets to %s\n", argv[i + 1]);
+        return false;
+      }
+      printf("Capturing packets to %s\n", argv[i + 1]);
+    }
+  return true;
+}
+
+void packet_capture(const ENetPacket *packet)
+{
+  if (!captureEnabled.load(std::memory_order_acquire) || packet->dataLength == 0)
+    return;
+  std::lock_guard<std::mutex> lock(captureMutex);
+  const uint8_t type = packet->data[0];
+  const uint32_t count = captureCounts[type]++;
+  if (count >= 16 && (count & (count - 1)) != 0)
+    return;
+  const char *name = captureTypeName ? captureTypeName(type) : nullptr;
+  char path[64];
+  if (name)
+    snprintf(path, sizeof(path), "/%s-%u.bin", name, count);
+  else
+    snprintf(path, sizeof(path), "/type%u-%u.bin", type, count);
+  FILE *f = fopen((captureDir + path).c_str(), "wb");
+  if (!f)
+    return;
+  fwrite(packet->data, 1, packet->dataLength, f);
+  fclose(f);
+}
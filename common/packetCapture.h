@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <enet/enet.h>
+
+// Запись отправленных пакетов в каталог, по файлу на пакет (<тип>-<номер>.bin): затравочный корпус для fuzz-цели недели.
+// Каждого типа пишутся первые 16 пакетов, дальше только с номерами-степенями двойки, чтобы корпус оставался
+// маленьким, но захватывал и начало сессии, и позднее состояние мира
+
+// Имя типа сообщения для имени файла (message_type_name недели), nullptr - файл называется по номеру типа
+typedef const char *(*PacketCaptureTypeName)(uint8_t type);
+
+// Каталог должен существовать
+bool packet_capture_open(const char *dir, PacketCaptureTypeName typeName);
+// --capture-packets <каталог>; false, если флаг есть, но каталог не открылся
+bool packet_capture_open_from_args(int argc, const char **argv, PacketCaptureTypeName typeName);
+void packet_capture(const ENetPacket *packet);
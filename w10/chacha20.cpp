@@ -0,0 +1,243 @@
+#include "chacha20.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CHACHA20_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHACHA20_SSE2 1
+#endif
+
+// "expand 32-byte k"
+static constexpr uint32_t CHACHA20_CONSTANTS[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+
+static void init_state(uint32_t state[16], const uint32_t key[CHACHA20_KEY_WORDS],
+                       const uint32_t nonce[CHACHA20_NONCE_WORDS], uint32_t counter)
+{
+  memcpy(state, CHACHA20_CONSTANTS, sizeof(CHACHA20_CONSTANTS));
+  memcpy(state + 4, key, CHACHA20_KEY_WORDS * sizeof(uint32_t));
+  state[12] = counter;
+  memcpy(state + 13, nonce, CHACHA20_NONCE_WORDS * sizeof(uint32_t));
+}
+
+static inline uint32_t rotl(uint32_t v, int n)
+{
+  return (v << n) | (v >> (32 - n));
+}
+
+static inline void quarter_round(uint32_t &a, uint32_t &b, uint32_t &c, uint32_t &d)
+{
+  a += b; d ^= a; d = rotl(d, 16);
+  c += d; b ^= c; b = rotl(b, 12);
+  a += b; d ^= a; d = rotl(d, 8);
+  c += d; b ^= c; b = rotl(b, 7);
+}
+
+static void xor_block_scalar(const uint32_t state[16], uint8_t *data, size_t size)
+{
+  uint32_t x[16];
+  memcpy(x, state, sizeof(x));
+  for (int i = 0; i < 10; ++i)
+  {
+    quarter_round(x[0], x[4], x[8], x[12]);
+    quarter_round(x[1], x[5], x[9], x[13]);
+    quarter_round(x[2], x[6], x[10], x[14]);
+    quarter_round(x[3], x[7], x[11], x[15]);
+    quarter_round(x[0], x[5], x[10], x[15]);
+    quarter_round(x[1], x[6], x[11], x[12]);
+    quarter_round(x[2], x[7], x[8], x[13]);
+    quarter_round(x[3], x[4], x[9], x[14]);
+  }
+  // слова ключевого потока в little-endian независимо от платформы
+  for (size_t i = 0; i < size; ++i)
+    data[i] ^= static_cast<uint8_t>((x[i / 4] + state[i / 4]) >> (8 * (i % 4)));
+}
+
+void chacha20_xor_scalar(const uint32_t key[CHACHA20_KEY_WORDS], const uint32_t nonce[CHACHA20_NONCE_WORDS],
+                         uint32_t counter, uint8_t *data, size_t size)
+{
+  uint32_t state[16];
+  init_state(state, key, nonce, counter);
+  for (size_t pos = 0; pos < size; pos += CHACHA20_BLOCK_SIZE, ++state[12])
+    xor_block_scalar(state, data + pos, size - pos < CHACHA20_BLOCK_SIZE ? size - pos : CHACHA20_BLOCK_SIZE);
+}
+
+#ifdef CHACHA20_SSE2
+// SSE2 без pshufb: поворот - два сдвига и or, на 16 - перестановка половин слов
+template<int N>
+static inline __m128i rotl128(__m128i v)
+{
+  if constexpr (N == 16)
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+  else
+    return _mm_or_si128(_mm_slli_epi32(v, N), _mm_srli_epi32(v, 32 - N));
+}
+
+static inline void xor_bytes(uint8_t *data, __m128i keystream)
+{
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(data), _mm_xor_si128(v, keystream));
+}
+
+// Четыре блока сразу: в каждом регистре одно слово состояния для четырех блоков (счетчики counter..counter+3)
+static void xor_4blocks_sse2(const uint32_t state[16], uint8_t *data)
+{
+  __m128i x[16];
+  __m128i orig[16];
+  for (int i = 0; i < 16; ++i)
+    orig[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+  orig[12] = _mm_add_epi32(orig[12], _mm_set_epi32(3, 2, 1, 0));
+  memcpy(x, orig, sizeof(x));
+
+#define CHACHA20_QR4(a, b, c, d) \
+  x[a] = _mm_add_epi32(x[a], x[b]); x[d] = rotl128<16>(_mm_xor_si128(x[d], x[a])); \
+  x[c] = _mm_add_epi32(x[c], x[d]); x[b] = rotl128<12>(_mm_xor_si128(x[b], x[c])); \
+  x[a] = _mm_add_epi32(x[a], x[b]); x[d] = rotl128<8>(_mm_xor_si128(x[d], x[a]));  \
+  x[c] = _mm_add_epi32(x[c], x[d]); x[b] = rotl128<7>(_mm_xor_si128(x[b], x[c]));
+  for (int i = 0; i < 10; ++i)
+  {
+    CHACHA20_QR4(0, 4, 8, 12) CHACHA20_QR4(1, 5, 9, 13) CHACHA20_QR4(2, 6, 10, 14) CHACHA20_QR4(3, 7, 11, 15)
+    CHACHA20_QR4(0, 5, 10, 15) CHACHA20_QR4(1, 6, 11, 12) CHACHA20_QR4(2, 7, 8, 13) CHACHA20_QR4(3, 4, 9, 14)
+  }
+#undef CHACHA20_QR4
+
+  // транспонирование 4x4 по четверкам слов: из "слово для 4 блоков" в "4 слова одного блока"
+  for (int g = 0; g < 4; ++g)
+  {
+    const __m128i a = _mm_add_epi32(x[4 * g + 0], orig[4 * g + 0]);
+    const __m128i b = _mm_add_epi32(x[4 * g + 1], orig[4 * g + 1]);
+    const __m128i c = _mm_add_epi32(x[4 * g + 2], orig[4 * g + 2]);
+    const __m128i d = _mm_add_epi32(x[4 * g + 3], orig[4 * g + 3]);
+    const __m128i ab01 = _mm_unpacklo_epi32(a, b);
+    const __m128i ab23 = _mm_unpackhi_epi32(a, b);
+    const __m128i cd01 = _mm_unpacklo_epi32(c, d);
+    const __m128i cd23 = _mm_unpackhi_epi32(c, d);
+    xor_bytes(data + 0 * CHACHA20_BLOCK_SIZE + 16 * g, _mm_unpacklo_epi64(ab01, cd01));
+    xor_bytes(data + 1 * CHACHA20_BLOCK_SIZE + 16 * g, _mm_unpackhi_epi64(ab01, cd01));
+    xor_bytes(data + 2 * CHACHA20_BLOCK_SIZE + 16 * g, _mm_unpacklo_epi64(ab23, cd23));
+    xor_bytes(data + 3 * CHACHA20_BLOCK_SIZE + 16 * g, _mm_unpackhi_epi64(ab23, cd23));
+  }
+}
+
+// Один блок построчно: четверть-раунды над строками сразу, для диагоналей строки сдвигаются перестановкой.
+// Это путь коротких пакетов, которым хватает одного блока
+static void xor_block_sse2(const uint32_t state[16], uint8_t *data, size_t size)
+{
+  const __m128i orig[4] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 0)),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 8)),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 12))};
+  __m128i a = orig[0], b = orig[1], c = orig[2], d = orig[3];
+#define CHACHA20_QR_ROWS() \
+  a = _mm_add_epi32(a, b); d = rotl128<16>(_mm_xor_si128(d, a)); \
+  c = _mm_add_epi32(c, d); b = rotl128<12>(_mm_xor_si128(b, c)); \
+  a = _mm_add_epi32(a, b); d = rotl128<8>(_mm_xor_si128(d, a));  \
+  c = _mm_add_epi32(c, d); b = rotl128<7>(_mm_xor_si128(b, c));
+  for (int i = 0; i < 10; ++i)
+  {
+    CHACHA20_QR_ROWS()
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+    c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm_shuffle_epi32(d, _MM_SHUFFLE(2, 1, 0, 3));
+    CHACHA20_QR_ROWS()
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3));
+    c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm_shuffle_epi32(d, _MM_SHUFFLE(0, 3, 2, 1));
+  }
+#undef CHACHA20_QR_ROWS
+  alignas(16) uint8_t keystream[CHACHA20_BLOCK_SIZE];
+  _mm_store_si128(reinterpret_cast<__m128i*>(keystream + 0), _mm_add_epi32(a, orig[0]));
+  _mm_store_si128(reinterpret_cast<__m128i*>(keystream + 16), _mm_add_epi32(b, orig[1]));
+  _mm_store_si128(reinterpret_cast<__m128i*>(keystream + 32), _mm_add_epi32(c, orig[2]));
+  _mm_store_si128(reinterpret_cast<__m128i*>(keystream + 48), _mm_add_epi32(d, orig[3]));
+  if (size == CHACHA20_BLOCK_SIZE)
+  {
+    for (int i = 0; i < 4; ++i)
+      xor_bytes(data + 16 * i, _mm_load_si128(reinterpret_cast<const __m128i*>(keystream + 16 * i)));
+    return;
+  }
+  for (size_t i = 0; i < size; ++i)
+    data[i] ^= keystream[i];
+}
+#endif
+
+#ifdef CHACHA20_AVX2
+// на AVX2 есть vpshufb, поворот на 16 и 8 - перестановка байтов
+template<int N>
+static inline __m256i rotl256(__m256i v)
+{
+  if constexpr (N == 16)
+    return _mm256_shuffle_epi8(v, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                                  13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+  else if constexpr (N == 8)
+    return _mm256_shuffle_epi8(v, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                                  14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+  else
+    return _mm256_or_si256(_mm256_slli_epi32(v, N), _mm256_srli_epi32(v, 32 - N));
+}
+
+// Восемь блоков: как xor_4blocks_sse2, после транспонирования в младших 128 битах блоки 0-3, в старших 4-7
+static void xor_8blocks_avx2(const uint32_t state[16], uint8_t *data)
+{
+  __m256i x[16];
+  __m256i orig[16];
+  for (int i = 0; i < 16; ++i)
+    orig[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+  orig[12] = _mm256_add_epi32(orig[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+  memcpy(x, orig, sizeof(x));
+
+#define CHACHA20_QR8(a, b, c, d) \
+  x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = rotl256<16>(_mm256_xor_si256(x[d], x[a])); \
+  x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = rotl256<12>(_mm256_xor_si256(x[b], x[c])); \
+  x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = rotl256<8>(_mm256_xor_si256(x[d], x[a]));  \
+  x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = rotl256<7>(_mm256_xor_si256(x[b], x[c]));
+  for (int i = 0; i < 10; ++i)
+  {
+    CHACHA20_QR8(0, 4, 8, 12) CHACHA20_QR8(1, 5, 9, 13) CHACHA20_QR8(2, 6, 10, 14) CHACHA20_QR8(3, 7, 11, 15)
+    CHACHA20_QR8(0, 5, 10, 15) CHACHA20_QR8(1, 6, 11, 12) CHACHA20_QR8(2, 7, 8, 13) CHACHA20_QR8(3, 4, 9, 14)
+  }
+#undef CHACHA20_QR8
+
+  for (int g = 0; g < 4; ++g)
+  {
+    const __m256i a = _mm256_add_epi32(x[4 * g + 0], orig[4 * g + 0]);
+    const __m256i b = _mm256_add_epi32(x[4 * g + 1], orig[4 * g + 1]);
+    const __m256i c = _mm256_add_epi32(x[4 * g + 2], orig[4 * g + 2]);
+    const __m256i d = _mm256_add_epi32(x[4 * g + 3], orig[4 * g + 3]);
+    const __m256i ab01 = _mm256_unpacklo_epi32(a, b);
+    const __m256i ab23 = _mm256_unpackhi_epi32(a, b);
+    const __m256i cd01 = _mm256_unpacklo_epi32(c, d);
+    const __m256i cd23 = _mm256_unpackhi_epi32(c, d);
+    const __m256i rows[4] = {_mm256_unpacklo_epi64(ab01, cd01), _mm256_unpackhi_epi64(ab01, cd01),
+                             _mm256_unpacklo_epi64(ab23, cd23), _mm256_unpackhi_epi64(ab23, cd23)};
+    for (int j = 0; j < 4; ++j)
+    {
+      xor_bytes(data + j * CHACHA20_BLOCK_SIZE + 16 * g, _mm256_castsi256_si128(rows[j]));
+      xor_bytes(data + (j + 4) * CHACHA20_BLOCK_SIZE + 16 * g, _mm256_extracti128_si256(rows[j], 1));
+    }
+  }
+}
+#endif
+
+void chacha20_xor(const uint32_t key[CHACHA20_KEY_WORDS], const uint32_t nonce[CHACHA20_NONCE_WORDS], uint32_t counter,
+                  uint8_t *data, size_t size)
+{
+  uint32_t state[16];
+  init_state(state, key, nonce, counter);
+  size_t pos = 0;
+#ifdef CHACHA20_AVX2
+  for (; size - pos >= 8 * CHACHA20_BLOCK_SIZE; pos += 8 * CHACHA20_BLOCK_SIZE, state[12] += 8)
+    xor_8blocks_avx2(state, data + pos);
+#endif
+#ifdef CHACHA20_SSE2
+  for (; size - pos >= 4 * CHACHA20_BLOCK_SIZE; pos += 4 * CHACHA20_BLOCK_SIZE, state[12] += 4)
+    xor_4blocks_sse2(state, data + pos);
+  for (; pos < size; pos += CHACHA20_BLOCK_SIZE, ++state[12])
+    xor_block_sse2(state, data + pos, size - pos < CHACHA20_BLOCK_SIZE ? size - pos : CHACHA20_BLOCK_SIZE);
+#else
+  for (; pos < size; pos += CHACHA20_BLOCK_SIZE, ++state[12])
+    xor_block_scalar(state, data + pos, size - pos < CHACHA20_BLOCK_SIZE ? size - pos : CHACHA20_BLOCK_SIZE);
+#endif
+}
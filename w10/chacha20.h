@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Потоковый шифр ChaCha20 (RFC 8439): 256-битный ключ, 96-битный nonce и 32-битный счетчик блоков.
+// Данные XOR-ятся с ключевым потоком на месте, шифрование и расшифровка - одна и та же операция.
+// Один и тот же nonce с одним ключом повторять нельзя: протокол берет его из счетчика пакетов.
+// Блоки считаются по 8 (AVX2) или по 4 (SSE2) сразу, одиночный блок на SSE2 - построчно, на прочих платформах скалярно
+
+constexpr size_t CHACHA20_KEY_WORDS = 8;
+constexpr size_t CHACHA20_NONCE_WORDS = 3;
+constexpr size_t CHACHA20_BLOCK_SIZE = 64;
+
+void chacha20_xor(const uint32_t key[CHACHA20_KEY_WORDS], const uint32_t nonce[CHACHA20_NONCE_WORDS], uint32_t counter,
+                  uint8_t *data, size_t size);
+
+// Скалярная версия по RFC для проверки векторных
+void chacha20_xor_scalar(const uint32_t key[CHACHA20_KEY_WORDS], const uint32_t nonce[CHACHA20_NONCE_WORDS],
+                         uint32_t counter, uint8_t *data, size_t size);
@@ -0,0 +1,89 @@
+// Скорость шифрования пакетов: прежний XOR с повторяющимся 4-байтным ключом против ChaCha20 (скалярного и векторного)
+// и ChaCha20 с тегом SipHash, как в протоколе.
+// Использование: w10_cipher_bench [--packets N]
+// Для каждого размера пакета шифруется N пакетов на месте с новым nonce на каждый, как в протоколе
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "chacha20.h"
+#include "siphash.h"
+
+// Прежняя защита пакетов из protocol.cpp, побайтово
+static void xor_packet_data(uint8_t *data, size_t size, const uint8_t *key)
+{
+  uint8_t *ptr = data + sizeof(uint8_t);
+  uint8_t *end = data + size;
+  for (int i = 0; ptr < end; ++ptr, ++i)
+  {
+    i = i % 4;
+    *ptr ^= key[i];
+  }
+}
+
+template<typename Cipher>
+static double bench(std::vector<uint8_t> &data, size_t packetSize, size_t packets, Cipher cipher)
+{
+  const size_t inBuffer = data.size() / packetSize;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < packets; ++i)
+    cipher(&data[(i % inBuffer) * packetSize], static_cast<uint32_t>(i));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, const char **argv)
+{
+  size_t packets = 1000000;
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "--packets") == 0)
+      packets = std::max(atoi(argv[i + 1]), 1);
+
+  uint32_t key[CHACHA20_KEY_WORDS];
+  for (uint32_t &word : key)
+    word = static_cast<uint32_t>(rand());
+  const uint32_t xorKey = key[0];
+  const uint64_t macKey[SIPHASH_KEY_WORDS] = {uint64_t(rand()) << 32 | rand(), uint64_t(rand()) << 32 | rand()};
+
+  // буфер меньше L2, чтобы мерить шифр, а не память
+  std::vector<uint8_t> data(64 * 1024);
+  for (uint8_t &b : data)
+    b = static_cast<uint8_t>(rand());
+
+  // 23 байта - пакет ввода w10 (заголовок 5 байт, 10 байт полезного груза и 8 байт тега)
+  const size_t sizes[] = {23, 64, 256, 1024, 1400};
+  printf("%-8s %-16s %12s %10s\n", "size", "cipher", "Mpackets/s", "MB/s");
+  for (size_t size : sizes)
+  {
+    struct Result { const char *name; double seconds; } results[] = {
+      {"xor", bench(data, size, packets, [&](uint8_t *p, uint32_t) {
+         xor_packet_data(p, size, reinterpret_cast<const uint8_t*>(&xorKey));
+       })},
+      {"chacha20 scalar", bench(data, size, packets, [&](uint8_t *p, uint32_t sequence) {
+         const uint32_t nonce[CHACHA20_NONCE_WORDS] = {sequence, 0, 0};
+         chacha20_xor_scalar(key, nonce, 0, p + 5, size - 5);
+       })},
+      {"chacha20", bench(data, size, packets, [&](uint8_t *p, uint32_t sequence) {
+         const uint32_t nonce[CHACHA20_NONCE_WORDS] = {sequence, 0, 0};
+         chacha20_xor(key, nonce, 0, p + 5, size - 5);
+       })},
+      {"chacha20+siphash", bench(data, size, packets, [&](uint8_t *p, uint32_t sequence) {
+         const uint32_t nonce[CHACHA20_NONCE_WORDS] = {sequence, 0, 0};
+         chacha20_xor(key, nonce, 0, p + 5, size - 5 - SIPHASH_TAG_SIZE);
+         const uint64_t tag = siphash24(macKey, p, size - SIPHASH_TAG_SIZE);
+         memcpy(p + size - SIPHASH_TAG_SIZE, &tag, SIPHASH_TAG_SIZE);
+       })},
+    };
+    for (const Result &r : results)
+      printf("%-8zu %-16s %12.2f %10.0f\n", size, r.name, packets / r.seconds * 1e-6,
+             double(packets) * size / r.seconds / (1024.0 * 1024.0));
+  }
+  // чтобы компилятор не выбросил шифрование как неиспользуемое
+  uint32_t checksum = 0;
+  for (uint8_t b : data)
+    checksum = checksum * 31 + b;
+  printf("checksum %08x\n", checksum);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "fuzzDriver.h"
+#include "protocol.h"
+#include <cstring>
+
+// Ключи последнего пакета E_SERVER_TO_CLIENT_KEY из корпуса, до него нулевые
+static CipherSession fuzzSession;
+
+void fuzz_deserialize(ENetPacket *packet)
+{
+  switch (get_packet_type(packet))
+  {
+  case E_CLIENT_TO_SERVER_JOIN:
+    break;
+  case E_SERVER_TO_CLIENT_NEW_ENTITY:
+    {
+      Entity ent;
+      deserialize_new_entity(packet, ent);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY:
+    {
+      uint16_t eid = invalid_entity;
+      deserialize_set_controlled_entity(packet, eid);
+    }
+    break;
+  case E_CLIENT_TO_SERVER_INPUT:
+    {
+      // Те же проверки, что в check_input на сервере: разбирается только пакет нужной длины, прошедший decipher_data
+      if (packet->dataLength != INPUT_PACKET_SIZE)
+        break;
+      uint16_t eid = invalid_entity;
+      float thr = 0.f; float steer = 0.f;
+      // Сессия своя на каждый вход, чтобы окно повторов не зависело от прежних входов
+      CipherSession session = fuzzSession;
+      PacketCheck check = decipher_data(packet, session);
+      if (check == E_PACKET_BAD_TAG)
+      {
+        // Испорченный пакет с тегом не сходится, поэтому дальше тега фаззинг проходит только так:
+        // пакет намеренно переподписывается ключом сессии и проверяется заново
+        session = fuzzSession;
+        const uint64_t tag = siphash24(session.macKey, packet->data, packet->dataLength - SIPHASH_TAG_SIZE);
+        memcpy(packet->data + packet->dataLength - SIPHASH_TAG_SIZE, &tag, SIPHASH_TAG_SIZE);
+        check = decipher_data(packet, session);
+      }
+      if (check == E_PACKET_OK)
+        deserialize_entity_input(packet, eid, thr, steer);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SNAPSHOT:
+    {
+      uint16_t eid = invalid_entity;
+      float x = 0.f; float y = 0.f; float ori = 0.f;
+      deserialize_snapshot(packet, eid, x, y, ori);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_KEY:
+    if (deserialize_and_set_key(packet))
+    {
+      // ключи сессии берутся из пакета ключа в корпусе: с ними записанный ввод расшифровывается в настоящие значения
+      const uint8_t *ptr = packet->data + sizeof(uint8_t);
+      memcpy(fuzzSession.key, ptr, sizeof(fuzzSession.key)); ptr += sizeof(fuzzSession.key);
+      memcpy(fuzzSession.macKey, ptr, sizeof(fuzzSession.macKey));
+    }
+    break;
+  }
+}
@@ -4,10 +4,14 @@
 #include "raylib.h"
 #include <enet/enet.h>
 #include <math.h>
+#include <cstring>
+#include <cstdlib>
 
 #include <vector>
 #include "entity.h"
 #include "protocol.h"
+#include "packetCapture.h"
+#include "netStats.h"
 
 
 static std::vector<Entity> entities;
@@ -16,7 +20,8 @@ static uint16_t my_entity = invalid_entity;
 void on_new_entity_packet(ENetPacket *packet)
 {
   Entity newEntity;
-  deserialize_new_entity(packet, newEntity);
+  if (!deserialize_new_entity(packet, newEntity))
+    return;
   // TODO: Direct adressing, of course!
   for (const Entity &e : entities)
     if (e.eid == newEntity.eid)
@@ -33,7 +38,8 @@ void on_snapshot(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float x = 0.f; float y = 0.f; float ori = 0.f;
-  deserialize_snapshot(packet, eid, x, y, ori);
+  if (!deserialize_snapshot(packet, eid, x, y, ori))
+    return;
   // TODO: Direct adressing, of course!
   for (Entity &e : entities)
     if (e.eid == eid)
@@ -51,6 +57,15 @@ void on_key(ENetPacket *packet)
 
 int main(int argc, const char **argv)
 {
+  // --fuzz <fraction>: портить долю пакетов ввода после тега, чтобы увидеть, как сервер их отбрасывает
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "--fuzz") == 0)
+      set_input_fuzzing(atof(argv[i + 1]));
+
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w10_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -113,6 +128,7 @@ int main(int argc, const char **argv)
         connected = true;
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
         case E_SERVER_TO_CLIENT_NEW_ENTITY:
@@ -149,6 +165,8 @@ int main(int argc, const char **argv)
 
           // Send
           send_entity_input(serverPeer, my_entity, thr, steer);
+          // за окном [-16, 16] x [-8, 8] положения приходят точными, камера следует за своей сущностью
+          camera.target = Vector2{ e.x, e.y };
         }
     }
 
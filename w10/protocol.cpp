@@ -3,48 +3,64 @@
 #include <cstring> // memcpy
 #include <iostream>
 #include <stdlib.h>
+#include "netStats.h"
+#include "netSend.h"
 
-static uint32_t xorCipherKey = 0;
+static CipherSession clientCipher;
 
 void send_join(ENetPeer *peer)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_JOIN);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t), ENET_PACKET_FLAG_RELIABLE);
   *packet->data = E_CLIENT_TO_SERVER_JOIN;
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_new_entity(ENetPeer *peer, const Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_NEW_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(Entity),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_NEW_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &ent, sizeof(Entity)); ptr += sizeof(Entity);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
-void send_cipher_key(ENetPeer *peer, uint32_t key)
+void send_cipher_key(ENetPeer *peer, const uint32_t key[CHACHA20_KEY_WORDS], const uint64_t macKey[SIPHASH_KEY_WORDS])
 {
-  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint32_t),
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_KEY);
+  constexpr size_t keySize = CHACHA20_KEY_WORDS * sizeof(uint32_t);
+  constexpr size_t macKeySize = SIPHASH_KEY_WORDS * sizeof(uint64_t);
+  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + keySize + macKeySize,
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_KEY; ptr += sizeof(uint8_t);
-  memcpy(ptr, &key, sizeof(uint32_t)); ptr += sizeof(uint32_t);
+  memcpy(ptr, key, keySize); ptr += keySize;
+  memcpy(ptr, macKey, macKeySize); ptr += macKeySize;
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
+}
+
+static float inputFuzzing = 0.f;
+
+void set_input_fuzzing(float fraction)
+{
+  inputFuzzing = fraction;
 }
 
 void fuzz_packet_data(ENetPacket *packet)
@@ -54,12 +70,12 @@ void fuzz_packet_data(ENetPacket *packet)
 
 void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float ori)
 {
-  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t) +
-                                                   sizeof(float) * 2,
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_INPUT);
+  ENetPacket *packet = enet_packet_create(nullptr, INPUT_PACKET_SIZE,
                                                    //sizeof(uint8_t),
                                                    ENET_PACKET_FLAG_UNSEQUENCED);
   uint8_t *ptr = packet->data;
-  *ptr = E_CLIENT_TO_SERVER_INPUT; ptr += sizeof(uint8_t);
+  *ptr = E_CLIENT_TO_SERVER_INPUT; ptr += CIPHER_HEADER_SIZE; // номер пакета и тег пишет cipher_data
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
   memcpy(ptr, &thr, sizeof(float)); ptr += sizeof(float);
   memcpy(ptr, &ori, sizeof(float)); ptr += sizeof(float);
@@ -74,18 +90,26 @@ void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float ori)
   memcpy(ptr, &oriPacked, sizeof(uint8_t)); ptr += sizeof(uint8_t);
   */
 
-  fuzz_packet_data(packet);
   cipher_data(packet);
+  if (inputFuzzing > 0.f && rand() < inputFuzzing * RAND_MAX)
+    fuzz_packet_data(packet);
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
+// Положение внутри окна [-16, 16] x [-8, 8] квантуется как раньше. За окном старший бит xPacked поднят,
+// а после ori идут точные x и y, поэтому сущность не упирается в рамку окна
+static constexpr uint16_t SNAPSHOT_POSITION_ESCAPE = 0x8000;
+
 void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y, float ori)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SNAPSHOT);
+  const bool inWindow = x >= -16.f && x <= 16.f && y >= -8.f && y <= 8.f;
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t) +
                                                    sizeof(uint16_t) +
                                                    sizeof(uint16_t) +
-                                                   sizeof(uint8_t),
+                                                   sizeof(uint8_t) +
+                                                   (inWindow ? 0 : sizeof(float) * 2),
                                                    ENET_PACKET_FLAG_UNSEQUENCED);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_SNAPSHOT; ptr += sizeof(uint8_t);
@@ -93,12 +117,19 @@ void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y, float ori)
   uint16_t xPacked = pack_float<uint16_t>(x, -16.f, 16.f, 11);
   uint16_t yPacked = pack_float<uint16_t>(y, -8.f, 8.f, 10);
   uint8_t oriPacked = pack_float<uint8_t>(ori, -PI, PI, 8);
+  if (!inWindow)
+    xPacked |= SNAPSHOT_POSITION_ESCAPE;
   //printf("xPacked/unpacked %d %f\n", xPacked, x);
   memcpy(ptr, &xPacked, sizeof(uint16_t)); ptr += sizeof(uint16_t);
   memcpy(ptr, &yPacked, sizeof(uint16_t)); ptr += sizeof(uint16_t);
   memcpy(ptr, &oriPacked, sizeof(uint8_t)); ptr += sizeof(uint8_t);
+  if (!inWindow)
+  {
+    memcpy(ptr, &x, sizeof(float)); ptr += sizeof(float);
+    memcpy(ptr, &y, sizeof(float)); ptr += sizeof(float);
+  }
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
 MessageType get_packet_type(ENetPacket *packet)
@@ -106,42 +137,104 @@ MessageType get_packet_type(ENetPacket *packet)
   return (MessageType)*packet->data;
 }
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent)
+const char *message_type_name(uint8_t type)
+{
+  switch (type)
+  {
+  case E_CLIENT_TO_SERVER_JOIN: return "join";
+  case E_SERVER_TO_CLIENT_NEW_ENTITY: return "new_entity";
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY: return "set_controlled_entity";
+  case E_CLIENT_TO_SERVER_INPUT: return "input";
+  case E_SERVER_TO_CLIENT_SNAPSHOT: return "snapshot";
+  case E_SERVER_TO_CLIENT_KEY: return "key";
+  }
+  return nullptr;
+}
+
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_NEW_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(Entity))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   ent = *(Entity*)(ptr); ptr += sizeof(Entity);
+  return true;
 }
 
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint16_t))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
+  return true;
 }
 
-void xor_packet_data(ENetPacket *packet, uint8_t *key_ptr)
+// Третье слово nonce - направление: если сервер тоже начнет шифровать, его номера не совпадут с клиентскими
+static constexpr uint32_t CIPHER_CLIENT_TO_SERVER = 0;
+
+static void chacha20_packet(const CipherSession &session, uint32_t sequence, ENetPacket *packet)
 {
-  uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
-  uint8_t *end = packet->data + packet->dataLength;
-  for (int i = 0; ptr < end; ++ptr, ++i)
+  const uint32_t nonce[CHACHA20_NONCE_WORDS] = {sequence, 0, CIPHER_CLIENT_TO_SERVER};
+  chacha20_xor(session.key, nonce, 0, packet->data + CIPHER_HEADER_SIZE, packet->dataLength - CIPHER_OVERHEAD);
+}
+
+// Тег считается по шифротексту (encrypt-then-MAC), поэтому проверка не требует расшифровки
+static uint64_t packet_tag(const CipherSession &session, const ENetPacket *packet)
+{
+  return siphash24(session.macKey, packet->data, packet->dataLength - SIPHASH_TAG_SIZE);
+}
+
+// Окно в 64 номера, как в IPsec: пакеты без порядка доставки могут прийти в любом порядке, но каждый - один раз
+static bool accept_sequence(CipherSession &session, uint32_t sequence)
+{
+  if (sequence > session.recvHighest)
   {
-    i = i % 4;
-    *ptr ^= key_ptr[i];
+    // бит i окна - принят ли номер recvHighest - i
+    const uint32_t shift = sequence - session.recvHighest;
+    session.recvWindow = (shift < 64 ? session.recvWindow << shift : 0) | 1;
+    session.recvHighest = sequence;
+    return true;
   }
+  const uint32_t age = session.recvHighest - sequence;
+  if (age >= 64 || (session.recvWindow >> age) & 1)
+    return false;
+  session.recvWindow |= 1ull << age;
+  return true;
 }
 
 void cipher_data(ENetPacket *packet)
 {
-  xor_packet_data(packet, (uint8_t*)&xorCipherKey);
+  const uint32_t sequence = clientCipher.sendSequence++;
+  memcpy(packet->data + sizeof(uint8_t), &sequence, sizeof(uint32_t));
+  chacha20_packet(clientCipher, sequence, packet);
+  const uint64_t tag = packet_tag(clientCipher, packet);
+  memcpy(packet->data + packet->dataLength - SIPHASH_TAG_SIZE, &tag, SIPHASH_TAG_SIZE);
 }
 
-void decipher_data(ENetPacket *packet, ENetPeer *peer)
+PacketCheck decipher_data(ENetPacket *packet, CipherSession &session)
 {
-  xor_packet_data(packet, (uint8_t*)peer->data);
+  if (packet->dataLength < CIPHER_OVERHEAD)
+    return E_PACKET_MALFORMED;
+  const uint64_t tag = packet_tag(session, packet);
+  if (!constant_time_equal(reinterpret_cast<const uint8_t*>(&tag),
+                           packet->data + packet->dataLength - SIPHASH_TAG_SIZE, SIPHASH_TAG_SIZE))
+    return E_PACKET_BAD_TAG;
+  uint32_t sequence;
+  memcpy(&sequence, packet->data + sizeof(uint8_t), sizeof(uint32_t));
+  if (!accept_sequence(session, sequence))
+    return E_PACKET_REPLAYED;
+  chacha20_packet(session, sequence, packet);
+  return E_PACKET_OK;
 }
 
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer)
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer)
 {
-  uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_INPUT);
+  if (packet->dataLength < INPUT_PACKET_SIZE)
+    return false;
+  uint8_t *ptr = packet->data; ptr += CIPHER_HEADER_SIZE;
 
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
   thr = *(float*)(ptr); ptr += sizeof(float);
@@ -158,23 +251,42 @@ void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, flo
   thr = thrPacked.packedVal == neutralPackedValue ? 0.f : thrPacked.unpack(-1.f, 1.f);
   steer = steerPacked.packedVal == neutralPackedValue ? 0.f : steerPacked.unpack(-1.f, 1.f);
   */
+  return true;
 }
 
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori)
+bool deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SNAPSHOT);
+  constexpr size_t packedSize = sizeof(uint8_t) + sizeof(uint16_t) * 3 + sizeof(uint8_t);
+  if (packet->dataLength < packedSize)
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
   uint16_t xPacked = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
   uint16_t yPacked = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
   uint8_t oriPacked = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
-  x = unpack_float<uint16_t>(xPacked, -16.f, 16.f, 11);
+  x = unpack_float<uint16_t>(xPacked & ~SNAPSHOT_POSITION_ESCAPE, -16.f, 16.f, 11);
   y = unpack_float<uint16_t>(yPacked, -8.f, 8.f, 10);
   ori = unpack_float<uint8_t>(oriPacked, -PI, PI, 8);
+  if (xPacked & SNAPSHOT_POSITION_ESCAPE)
+  {
+    if (packet->dataLength < packedSize + sizeof(float) * 2)
+      return false;
+    x = *(float*)(ptr); ptr += sizeof(float);
+    y = *(float*)(ptr); ptr += sizeof(float);
+  }
+  return true;
 }
 
-void deserialize_and_set_key(ENetPacket *packet)
+bool deserialize_and_set_key(ENetPacket *packet)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_KEY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(clientCipher.key) + sizeof(clientCipher.macKey))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
-  xorCipherKey = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  memcpy(clientCipher.key, ptr, sizeof(clientCipher.key)); ptr += sizeof(clientCipher.key);
+  memcpy(clientCipher.macKey, ptr, sizeof(clientCipher.macKey)); ptr += sizeof(clientCipher.macKey);
+  clientCipher.sendSequence = 0;
+  return true;
 }
 
@@ -2,6 +2,8 @@
 #include <enet/enet.h>
 #include <cstdint>
 #include "entity.h"
+#include "chacha20.h"
+#include "siphash.h"
 
 enum MessageType : uint8_t
 {
@@ -16,18 +18,60 @@ enum MessageType : uint8_t
 void send_join(ENetPeer *peer);
 void send_new_entity(ENetPeer *peer, const Entity &ent);
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid);
-void send_cipher_key(ENetPeer *peer, uint32_t key);
+void send_cipher_key(ENetPeer *peer, const uint32_t key[CHACHA20_KEY_WORDS], const uint64_t macKey[SIPHASH_KEY_WORDS]);
 void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float steer);
 void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y, float ori);
 
 MessageType get_packet_type(ENetPacket *packet);
+// Имя типа для счетчиков трафика, записи корпуса и fuzz-драйвера (common/), nullptr для неизвестного типа
+const char *message_type_name(uint8_t type);
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent);
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer);
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori);
-void deserialize_and_set_key(ENetPacket *packet);
+// false - пакет короче сообщения своего типа, его пропускают
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent);
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer);
+bool deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori);
+bool deserialize_and_set_key(ENetPacket *packet);
 
+// Шифрованный пакет: | type | sequence | ChaCha20(остальное) | tag |. Тип открыт, чтобы получатель знал, что делать с пакетом,
+// nonce - номер пакета отправителя и направление, поэтому ключевой поток ни для одного пакета не повторяется
+// (номер 32-битный: на 60 пакетах в секунду ключ надо сменить раньше, чем через два года).
+// tag - SipHash всего, что до него, уже зашифрованного: испорченный в пути или подделанный вслепую пакет
+// отбрасывается до расшифровки и разбора.
+// Ограничение: оба ключа приходят клиенту открытым текстом в E_SERVER_TO_CLIENT_KEY (send_cipher_key),
+// обмена ключами нет. Кто видел этот пакет, тот может и читать трафик, и считать верные теги,
+// поэтому от перехвата рукопожатия тег не защищает
+constexpr size_t CIPHER_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
+constexpr size_t CIPHER_OVERHEAD = CIPHER_HEADER_SIZE + SIPHASH_TAG_SIZE;
+// Пакет ввода: | type | sequence | eid | thr | steer | tag |, другой длины сервер не примет
+constexpr size_t INPUT_PACKET_SIZE = CIPHER_OVERHEAD + sizeof(uint16_t) + sizeof(float) * 2;
+
+// Состояние шифра соединения: у клиента одно, у сервера по одному на каждого пира
+struct CipherSession
+{
+  uint32_t key[CHACHA20_KEY_WORDS] = {};
+  uint64_t macKey[SIPHASH_KEY_WORDS] = {};
+  uint32_t sendSequence = 0;
+  // защита от повтора: наибольший принятый номер и маска принятых среди 64 номеров до него
+  uint32_t recvHighest = 0;
+  uint64_t recvWindow = 0;
+};
+
+// Итог проверки входящего пакета, он же индекс счетчика отброшенных пакетов у сервера
+enum PacketCheck : uint8_t
+{
+  E_PACKET_OK = 0,
+  E_PACKET_MALFORMED,
+  E_PACKET_BAD_TAG,
+  E_PACKET_REPLAYED,
+  E_PACKET_FOREIGN_ENTITY,
+  E_PACKET_CHECK_COUNT
+};
+
+// Пишет номер пакета, шифрует все после заголовка ключом клиента и дописывает тег
 void cipher_data(ENetPacket *packet);
-void decipher_data(ENetPacket *packet, ENetPeer *peer);
+// Проверяет длину, тег и номер пакета и только потом расшифровывает; при любой ошибке пакет не трогается
+PacketCheck decipher_data(ENetPacket *packet, CipherSession &session);
 
+// Доля пакетов ввода, в которых клиент портит случайный байт уже после тега (имитация подделки в сети), по умолчанию 0
+void set_input_fuzzing(float fraction);
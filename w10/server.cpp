@@ -2,15 +2,48 @@
 #include <iostream>
 #include "entity.h"
 #include "protocol.h"
+#include "netStats.h"
+#include "packetCapture.h"
 #include "mathUtils.h"
 #include <stdlib.h>
 #include <vector>
 #include <map>
+#include <iterator>
 #include <random>
 
 static std::vector<Entity> entities;
 static std::map<uint16_t, ENetPeer*> controlledMap;
 
+// Состояние пира в peer->data: шифр и счетчики пакетов ввода - принятых и отброшенных по каждой причине
+struct PeerSession
+{
+  CipherSession cipher;
+  uint32_t inputs[E_PACKET_CHECK_COUNT] = {};
+};
+
+static const char *packet_check_name(PacketCheck check)
+{
+  switch (check)
+  {
+  case E_PACKET_OK: return "accepted";
+  case E_PACKET_MALFORMED: return "malformed";
+  case E_PACKET_BAD_TAG: return "bad tag";
+  case E_PACKET_REPLAYED: return "replayed";
+  case E_PACKET_FOREIGN_ENTITY: return "foreign entity";
+  case E_PACKET_CHECK_COUNT: break;
+  }
+  return "?";
+}
+
+static void print_peer_inputs(const ENetPeer *peer)
+{
+  const PeerSession *session = static_cast<const PeerSession*>(peer->data);
+  printf("Inputs from %x:%u:", peer->address.host, peer->address.port);
+  for (int i = 0; i < E_PACKET_CHECK_COUNT; ++i)
+    printf(" %s %u", packet_check_name(PacketCheck(i)), session->inputs[i]);
+  printf("\n");
+}
+
 void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
 {
   // send all entities
@@ -39,19 +72,44 @@ void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
     send_new_entity(&host->peers[i], ent);
   // send info about controlled entity
   send_set_controlled_entity(peer, newEid);
-  uint32_t *keyPtr = (uint32_t*)peer->data;
-  std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  std::uniform_int_distribution<uint32_t> distrib(0);
-  *keyPtr = distrib(gen);
-  send_cipher_key(peer, *keyPtr);
+  // ключи прямо из random_device: mt19937 по 32-битному зерну дал бы всего 2^32 разных ключей
+  CipherSession &cipher = static_cast<PeerSession*>(peer->data)->cipher;
+  std::random_device rd;
+  for (uint32_t &word : cipher.key)
+    word = rd();
+  for (uint64_t &word : cipher.macKey)
+    word = (uint64_t(rd()) << 32) | rd();
+  // клиент с новым ключом начинает номера с нуля
+  cipher.recvHighest = 0;
+  cipher.recvWindow = 0;
+  send_cipher_key(peer, cipher.key, cipher.macKey);
+}
+
+// Дешевые проверки идут первыми: длина, тег, номер пакета и только потом расшифровка и разбор
+static PacketCheck check_input(ENetPacket *packet, ENetPeer *peer, uint16_t &eid, float &thr, float &steer)
+{
+  if (packet->dataLength != INPUT_PACKET_SIZE)
+    return E_PACKET_MALFORMED;
+  const PacketCheck check = decipher_data(packet, static_cast<PeerSession*>(peer->data)->cipher);
+  if (check != E_PACKET_OK)
+    return check;
+  if (!deserialize_entity_input(packet, eid, thr, steer))
+    return E_PACKET_MALFORMED;
+  // управлять можно только своей сущностью, даже с верным тегом
+  auto owner = controlledMap.find(eid);
+  if (owner == controlledMap.end() || owner->second != peer)
+    return E_PACKET_FOREIGN_ENTITY;
+  return E_PACKET_OK;
 }
 
-void on_input(ENetPacket *packet)
+void on_input(ENetPacket *packet, ENetPeer *peer)
 {
   uint16_t eid = invalid_entity;
   float thr = 0.f; float steer = 0.f;
-  deserialize_entity_input(packet, eid, thr, steer);
+  const PacketCheck check = check_input(packet, peer, eid, thr, steer);
+  static_cast<PeerSession*>(peer->data)->inputs[check]++;
+  if (check != E_PACKET_OK)
+    return;
   for (Entity &e : entities)
     if (e.eid == eid)
     {
@@ -62,6 +120,13 @@ void on_input(ENetPacket *packet)
 
 int main(int argc, const char **argv)
 {
+  NetStatsReporter netStats(message_type_name);
+  if (!netStats.openFromArgs(argc, argv))
+    return 1;
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w10_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -93,22 +158,26 @@ int main(int argc, const char **argv)
       {
       case ENET_EVENT_TYPE_CONNECT:
         printf("Connection with %x:%u established\n", event.peer->address.host, event.peer->address.port);
-        event.peer->data = new uint32_t;
-        *(uint32_t*)event.peer->data = 0;
+        event.peer->data = new PeerSession();
         break;
       case ENET_EVENT_TYPE_DISCONNECT:
         printf("Disconnected %x:%u \n", event.peer->address.host, event.peer->address.port);
-        delete event.peer->data;
+        print_peer_inputs(event.peer);
+        // ENet отдаст этот ENetPeer следующему соединению, и оно не должно управлять чужими сущностями
+        for (auto it = controlledMap.begin(); it != controlledMap.end();)
+          it = it->second == event.peer ? controlledMap.erase(it) : std::next(it);
+        delete static_cast<PeerSession*>(event.peer->data);
+        event.peer->data = nullptr;
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
           case E_CLIENT_TO_SERVER_JOIN:
             on_join(event.packet, event.peer, server);
             break;
           case E_CLIENT_TO_SERVER_INPUT:
-            decipher_data(event.packet, event.peer);
-            on_input(event.packet);
+            on_input(event.packet, event.peer);
             break;
         };
         enet_packet_destroy(event.packet);
@@ -131,6 +200,7 @@ int main(int argc, const char **argv)
         send_snapshot(peer, e.eid, e.x, e.y, e.ori);
       }
     }
+    netStats.update(curTime);
     usleep(10000);
   }
 
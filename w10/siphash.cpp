@@ -0,0 +1,65 @@
+#include "siphash.h"
+
+static inline uint64_t rotl(uint64_t v, int n)
+{
+  return (v << n) | (v >> (64 - n));
+}
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i)
+    v |= uint64_t(p[i]) << (8 * i);
+  return v;
+}
+
+struct SipState
+{
+  uint64_t v0, v1, v2, v3;
+
+  void round()
+  {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+  }
+
+  void compress(uint64_t m)
+  {
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+};
+
+uint64_t siphash24(const uint64_t key[SIPHASH_KEY_WORDS], const uint8_t *data, size_t size)
+{
+  SipState s = {key[0] ^ 0x736f6d6570736575ull, key[1] ^ 0x646f72616e646f6dull,
+                key[0] ^ 0x6c7967656e657261ull, key[1] ^ 0x7465646279746573ull};
+  const size_t fullWords = size / 8;
+  for (size_t i = 0; i < fullWords; ++i)
+    s.compress(load_le64(data + 8 * i));
+
+  // последнее слово: оставшиеся байты и длина в старшем байте
+  uint64_t last = uint64_t(size) << 56;
+  const uint8_t *tail = data + 8 * fullWords;
+  for (size_t i = 0; i < size % 8; ++i)
+    last |= uint64_t(tail[i]) << (8 * i);
+  s.compress(last);
+
+  s.v2 ^= 0xff;
+  for (int i = 0; i < 4; ++i)
+    s.round();
+  return s.v0 ^ s.v1 ^ s.v2 ^ s.v3;
+}
+
+bool constant_time_equal(const uint8_t *a, const uint8_t *b, size_t size)
+{
+  // volatile - чтобы компилятор не превратил накопление в ранний выход
+  volatile uint8_t diff = 0;
+  for (size_t i = 0; i < size; ++i)
+    diff = diff | (a[i] ^ b[i]);
+  return diff == 0;
+}
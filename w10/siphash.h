@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// SipHash-2-4: быстрая ключевая хеш-функция с 128-битным ключом и 64-битным результатом.
+// Для коротких пакетов это дешевая MAC: подделать тег без ключа можно только перебором
+
+constexpr size_t SIPHASH_KEY_WORDS = 2;
+constexpr size_t SIPHASH_TAG_SIZE = sizeof(uint64_t);
+
+uint64_t siphash24(const uint64_t key[SIPHASH_KEY_WORDS], const uint8_t *data, size_t size);
+
+// Сравнение за время, не зависящее от того, в каком байте первое отличие: иначе тег подбирался бы побайтово по задержке
+bool constant_time_equal(const uint8_t *a, const uint8_t *b, size_t size);
@@ -2,6 +2,7 @@
 #include <vector>
 #include <cstring>
 #include <cassert>
+#include <type_traits>
 
 class BitstreamWriter {
  public:
@@ -100,14 +101,22 @@ class BitstreamReader {
     BitstreamReader(BitstreamReader&& other) = delete;
     BitstreamReader& operator=(BitstreamReader&& other) = delete;
 
+    // false, если в буфере не хватает байт на все values: тогда не читается ни одно
     template<typename... Args>
-    void read(Args&&... values) {
+    bool read(Args&&... values) {
+        if (m_bufferSize - m_currentPos < (PackedSize<std::decay_t<Args>>::value + ... + 0)) {
+            return false;
+        }
         readValuesPack(values...);
+        return true;
     }
-    
-    void readData(char* data, uint32_t dataSize) {
-        assert(m_currentPos + dataSize <= m_bufferSize);
+
+    bool readData(char* data, uint32_t dataSize) {
+        if (m_bufferSize - m_currentPos < dataSize) {
+            return false;
+        }
         memcpy(data, &m_buffer[m_currentPos], dataSize);
+        return true;
     }
 
     void skip(uint32_t bytesToSkip) {
@@ -123,6 +132,12 @@ class BitstreamReader {
     };
 
  private:
+    // Сколько байт значение занимает в буфере: Skip<T> пропускает sizeof(T)
+    template<typename T>
+    struct PackedSize { static constexpr uint32_t value = sizeof(T); };
+    template<typename T>
+    struct PackedSize<Skip<T>> { static constexpr uint32_t value = sizeof(T); };
+
     template<typename T, typename... Args>
     void readValuesPack(T& value, Args&&... values) {
         assert(m_currentPos + sizeof(T) <= m_bufferSize);
@@ -0,0 +1,62 @@
+#include "fuzzDriver.h"
+#include "protocol.h"
+#include <string>
+
+void fuzz_deserialize(ENetPacket *packet)
+{
+  switch (get_packet_type(packet))
+  {
+  case E_CLIENT_TO_SERVER_JOIN:
+    {
+      std::string name;
+      deserialize_join(packet, name);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_NEW_ENTITY:
+    {
+      Entity ent;
+      deserialize_new_entity(packet, ent);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY:
+    {
+      uint16_t eid = invalid_entity;
+      deserialize_set_controlled_entity(packet, eid);
+    }
+    break;
+  case E_CLIENT_TO_SERVER_STATE:
+    {
+      uint16_t eid = invalid_entity;
+      float x = 0.f; float y = 0.f;
+      deserialize_entity_state(packet, eid, x, y);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SNAPSHOT:
+    {
+      uint16_t eid = invalid_entity;
+      float x = 0.f; float y = 0.f;
+      deserialize_snapshot(packet, eid, x, y);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_CHANGE_SIZE:
+    {
+      uint16_t eid = invalid_entity;
+      float radius = 0.f;
+      deserialize_change_size(packet, eid, radius);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_TELEPORT:
+    {
+      uint16_t eid = invalid_entity;
+      float x = 0.f; float y = 0.f;
+      deserialize_teleport(packet, eid, x, y);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SCORE:
+    {
+      std::string scoreListText;
+      deserialize_score(packet, scoreListText);
+    }
+    break;
+  }
+}
@@ -9,6 +9,8 @@
 #include <vector>
 #include "entity.h"
 #include "protocol.h"
+#include "packetCapture.h"
+#include "netStats.h"
 
 static std::vector<Entity> entities;
 static uint16_t my_entity = invalid_entity;
@@ -17,7 +19,8 @@ static std::string scoreListText = "Scores: ";
 void on_new_entity_packet(ENetPacket *packet)
 {
   Entity newEntity;
-  deserialize_new_entity(packet, newEntity);
+  if (!deserialize_new_entity(packet, newEntity))
+    return;
   // TODO: Direct adressing, of course!
   for (const Entity &e : entities)
     if (e.eid == newEntity.eid)
@@ -34,7 +37,8 @@ void on_snapshot(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float x = 0.f; float y = 0.f;
-  deserialize_snapshot(packet, eid, x, y);
+  if (!deserialize_snapshot(packet, eid, x, y))
+    return;
   // TODO: Direct adressing, of course!
   for (Entity &e : entities)
     if (e.eid == eid)
@@ -48,7 +52,8 @@ void on_change_size(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float radius;
-  deserialize_change_size(packet, eid, radius);
+  if (!deserialize_change_size(packet, eid, radius))
+    return;
   // TODO: Direct adressing, of course!
   for (Entity &e : entities)
     if (e.eid == eid)
@@ -61,7 +66,8 @@ void on_teleport(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float x, y;
-  deserialize_teleport(packet, eid, x, y);
+  if (!deserialize_teleport(packet, eid, x, y))
+    return;
   // TODO: Direct adressing, of course!
   for (Entity &e : entities)
     if (e.eid == eid)
@@ -78,6 +84,10 @@ void on_score(ENetPacket *packet)
 
 int main(int argc, const char **argv)
 {
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w4_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -139,6 +149,7 @@ int main(int argc, const char **argv)
         }
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
         case E_SERVER_TO_CLIENT_NEW_ENTITY:
@@ -2,79 +2,89 @@
 #include <cstring> // memcpy
 #include "bitstream.h"
 #include <iostream>
+#include "netStats.h"
+#include "netSend.h"
 
 void send_join(ENetPeer *peer, const std::string& name)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_JOIN);
   BitstreamWriter bs;
   bs.write(E_CLIENT_TO_SERVER_JOIN);
   bs.writeData(name.data(), name.size());
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_new_entity(ENetPeer *peer, const Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_NEW_ENTITY);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_NEW_ENTITY, ent);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY, eid);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_entity_state(ENetPeer *peer, uint16_t eid, float x, float y)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_STATE);
   BitstreamWriter bs;
   bs.write(E_CLIENT_TO_SERVER_STATE, eid, x, y);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_UNSEQUENCED);
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
 void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SNAPSHOT);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_SNAPSHOT, eid, x, y);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_UNSEQUENCED);
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
 void send_change_size(ENetPeer *peer, uint16_t eid, float radius)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_CHANGE_SIZE);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_CHANGE_SIZE, eid, radius);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_teleport(ENetPeer *peer, uint16_t eid, float x, float y)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_TELEPORT);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_TELEPORT, eid, x, y);
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_score(ENetPeer *peer, const std::string& scoreListText)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SCORE);
   BitstreamWriter bs;
   bs.write(E_SERVER_TO_CLIENT_SCORE);
   bs.writeData(scoreListText.data(), scoreListText.size());
   ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_RELIABLE);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 MessageType get_packet_type(ENetPacket *packet)
@@ -82,13 +92,31 @@ MessageType get_packet_type(ENetPacket *packet)
   return (MessageType)*packet->data;
 }
 
+const char *message_type_name(uint8_t type)
+{
+  switch (type)
+  {
+  case E_CLIENT_TO_SERVER_JOIN: return "join";
+  case E_SERVER_TO_CLIENT_NEW_ENTITY: return "new_entity";
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY: return "set_controlled_entity";
+  case E_CLIENT_TO_SERVER_STATE: return "state";
+  case E_SERVER_TO_CLIENT_SNAPSHOT: return "snapshot";
+  case E_SERVER_TO_CLIENT_CHANGE_SIZE: return "change_size";
+  case E_SERVER_TO_CLIENT_TELEPORT: return "teleport";
+  case E_SERVER_TO_CLIENT_SCORE: return "score";
+  }
+  return nullptr;
+}
+
 template<typename T>
 using Skip = BitstreamReader::Skip<T>;
 
-void deserialize_join(ENetPacket *packet, std::string& name)
+bool deserialize_join(ENetPacket *packet, std::string& name)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_JOIN);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>());
+  if (!bs.read(Skip<MessageType>()))
+    return false;
 
   uint32_t nameSize = packet->dataLength - sizeof(MessageType);
   std::vector<char> buffer(nameSize + 1);
@@ -96,50 +124,59 @@ void deserialize_join(ENetPacket *packet, std::string& name)
   buffer[buffer.size() - 1] = '\0';
 
   name = buffer.data();
+  return true;
 }
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent)
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_NEW_ENTITY);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
   // bs.skip(sizeof(uint8_t));
-  bs.read(Skip<MessageType>(), ent);
+  return bs.read(Skip<MessageType>(), ent);
 }
 
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>(), eid);
+  return bs.read(Skip<MessageType>(), eid);
 }
 
-void deserialize_entity_state(ENetPacket *packet, uint16_t &eid, float &x, float &y)
+bool deserialize_entity_state(ENetPacket *packet, uint16_t &eid, float &x, float &y)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_STATE);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>(), eid, x, y);
+  return bs.read(Skip<MessageType>(), eid, x, y);
 }
 
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y)
+bool deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SNAPSHOT);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
   // bs.read(Skip<MessageType>(), eid, Skip(x), y);
-  bs.read(Skip<MessageType>(), eid, x, y);
+  return bs.read(Skip<MessageType>(), eid, x, y);
 }
 
-void deserialize_change_size(ENetPacket *packet, uint16_t &eid, float &radius)
+bool deserialize_change_size(ENetPacket *packet, uint16_t &eid, float &radius)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_CHANGE_SIZE);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>(), eid, radius);
+  return bs.read(Skip<MessageType>(), eid, radius);
 }
 
-void deserialize_teleport(ENetPacket *packet, uint16_t &eid, float &x, float &y)
+bool deserialize_teleport(ENetPacket *packet, uint16_t &eid, float &x, float &y)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_TELEPORT);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>(), eid, x, y);
+  return bs.read(Skip<MessageType>(), eid, x, y);
 }
 
-void deserialize_score(ENetPacket *packet, std::string& scoreListText)
+bool deserialize_score(ENetPacket *packet, std::string& scoreListText)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SCORE);
   BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>());
+  if (!bs.read(Skip<MessageType>()))
+    return false;
 
   uint32_t scoreListTextSize = packet->dataLength - sizeof(MessageType);
   std::vector<char> buffer(scoreListTextSize + 1);
@@ -147,4 +184,5 @@ void deserialize_score(ENetPacket *packet, std::string& scoreListText)
   buffer[buffer.size() - 1] = '\0';
 
   scoreListText = buffer.data();
+  return true;
 }
\ No newline at end of file
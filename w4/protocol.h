@@ -26,12 +26,15 @@ void send_teleport(ENetPeer *peer, uint16_t eid, float x, float y);
 void send_score(ENetPeer *peer, const std::string& scoreListText);
 
 MessageType get_packet_type(ENetPacket *packet);
+// Имя типа для счетчиков трафика, записи корпуса и fuzz-драйвера (common/), nullptr для неизвестного типа
+const char *message_type_name(uint8_t type);
 
-void deserialize_join(ENetPacket *packet, std::string& name);
-void deserialize_new_entity(ENetPacket *packet, Entity &ent);
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
-void deserialize_entity_state(ENetPacket *packet, uint16_t &eid, float &x, float &y);
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y);
-void deserialize_change_size(ENetPacket *packet, uint16_t &eid, float &radius);
-void deserialize_teleport(ENetPacket *packet, uint16_t &eid, float &x, float &y);
-void deserialize_score(ENetPacket *peer, std::string& scoreListText);
\ No newline at end of file
+// false - пакет короче сообщения своего типа, его пропускают
+bool deserialize_join(ENetPacket *packet, std::string& name);
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent);
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
+bool deserialize_entity_state(ENetPacket *packet, uint16_t &eid, float &x, float &y);
+bool deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y);
+bool deserialize_change_size(ENetPacket *packet, uint16_t &eid, float &radius);
+bool deserialize_teleport(ENetPacket *packet, uint16_t &eid, float &x, float &y);
+bool deserialize_score(ENetPacket *peer, std::string& scoreListText);
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <iostream>
 #include "entity.h"
 #include "protocol.h"
+#include "netStats.h"
+#include "packetCapture.h"
 #include "player.h"
 #include <stdlib.h>
 #include <vector>
@@ -47,6 +49,10 @@ void sendScoreListToAllPeers(ENetHost *server) {
 
 void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
 {
+  std::string name;
+  if (!deserialize_join(packet, name))
+    return;
+
   // send all entities
   for (const Entity &ent : entities)
     send_new_entity(peer, ent);
@@ -55,8 +61,6 @@ void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
   uint16_t newEid = create_random_entity();
   const Entity& ent = entities[newEid];
 
-  std::string name;
-  deserialize_join(packet, name);
   if (name == "-none") {
     name = random_names[nextAvailableRandomName];
     nextAvailableRandomName = (nextAvailableRandomName + 1) % random_names.size();
@@ -76,7 +80,8 @@ void on_state(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float x = 0.f; float y = 0.f;
-  deserialize_entity_state(packet, eid, x, y);
+  if (!deserialize_entity_state(packet, eid, x, y))
+    return;
   for (Entity &e : entities)
     if (e.eid == eid)
     {
@@ -128,6 +133,13 @@ void simulateTryEat(Entity& e1, Entity& e2, ENetHost *server) {
 
 int main(int argc, const char **argv)
 {
+  NetStatsReporter netStats(message_type_name);
+  if (!netStats.openFromArgs(argc, argv))
+    return 1;
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w4_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -169,6 +181,7 @@ int main(int argc, const char **argv)
         printf("Connection with %x:%u established\n", event.peer->address.host, event.peer->address.port);
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
           case E_CLIENT_TO_SERVER_JOIN:
@@ -224,6 +237,7 @@ int main(int argc, const char **argv)
         }
       }
     }
+    netStats.update(curTime);
     //usleep(400000);
   }
 
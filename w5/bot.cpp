@@ -0,0 +1,214 @@
+// Нагрузочный клиент без окна: в одном процессе крутится много NetClient, которые управляются
+// синтетическими шаблонами руления, и на каждом работает полный путь предсказания, сверки и интерполяции.
+// Использование: w5_bot [--clients N] [--host HOST] [--port PORT] [--duration SECONDS] [--start-timeout SECONDS]
+// Больше 512 клиентов - только с w5_server --max-peers N
+#include <enet/enet.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "params.h"
+#include "netClient.h"
+#include "packetCapture.h"
+#include "netStats.h"
+
+enum SteeringPattern
+{
+  E_PATTERN_CIRCLE = 0,   // постоянный газ и поворот
+  E_PATTERN_SINE,         // плавное руление туда-обратно
+  E_PATTERN_ZIGZAG,       // резкая смена поворота каждые полсекунды
+  E_PATTERN_RANDOM,       // случайный ввод, меняется в случайные моменты
+  E_PATTERN_COUNT
+};
+
+static const char *pattern_name(SteeringPattern pattern)
+{
+  switch (pattern)
+  {
+  case E_PATTERN_CIRCLE: return "circle";
+  case E_PATTERN_SINE: return "sine";
+  case E_PATTERN_ZIGZAG: return "zigzag";
+  case E_PATTERN_RANDOM: return "random";
+  default: return "?";
+  }
+}
+
+struct Bot
+{
+  NetClient client;
+  SteeringPattern pattern = E_PATTERN_CIRCLE;
+  uint32_t seed = 1;
+  float thr = 0.f;
+  float steer = 0.f;
+  double updateSeconds = 0.0; // время в service и update этого клиента
+};
+
+static uint32_t next_random(uint32_t &state)
+{
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+static void steer_bot(Bot &bot, uint32_t frame)
+{
+  const float t = frame * (1.f / FPS);
+  switch (bot.pattern)
+  {
+  case E_PATTERN_CIRCLE:
+    bot.thr = 1.f;
+    bot.steer = 0.5f;
+    break;
+  case E_PATTERN_SINE:
+    bot.thr = 1.f;
+    bot.steer = sinf(t * 2.f);
+    break;
+  case E_PATTERN_ZIGZAG:
+    bot.thr = 1.f;
+    bot.steer = (frame / (FPS / 2)) % 2 == 0 ? -1.f : 1.f;
+    break;
+  case E_PATTERN_RANDOM:
+    if (next_random(bot.seed) % 20 == 0) {
+      bot.thr = float(next_random(bot.seed) % 3) - 1.f;
+      bot.steer = float(next_random(bot.seed) % 3) - 1.f;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  size_t nClients = 16;
+  const char *host = "localhost";
+  uint16_t port = 10131;
+  uint32_t duration = 30;
+  uint32_t startTimeout = 10;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--clients") == 0)
+      nClients = std::max(atoi(argv[i + 1]), 1);
+    else if (strcmp(argv[i], "--host") == 0)
+      host = argv[i + 1];
+    else if (strcmp(argv[i], "--port") == 0)
+      port = static_cast<uint16_t>(atoi(argv[i + 1]));
+    else if (strcmp(argv[i], "--duration") == 0)
+      duration = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+    else if (strcmp(argv[i], "--start-timeout") == 0)
+      startTimeout = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+  }
+
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w5_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
+  if (enet_initialize() != 0)
+  {
+    printf("Cannot init ENet");
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Bot>> bots;
+  for (size_t i = 0; i < nClients; ++i)
+  {
+    auto bot = std::make_unique<Bot>();
+    bot->pattern = static_cast<SteeringPattern>(i % E_PATTERN_COUNT);
+    bot->seed = static_cast<uint32_t>(i) + 1;
+    if (!bot->client.connect(host, port))
+      return 1;
+    bots.push_back(std::move(bot));
+  }
+
+  // все клиенты обслуживаются без ожидания, а цикл спит сам, иначе каждый service добавлял бы свою задержку.
+  // Лишние для сервера соединения (w5_server --max-peers) не установятся никогда, поэтому ждем не дольше startTimeout
+  using clock = std::chrono::steady_clock;
+  const auto startDeadline = clock::now() + std::chrono::seconds(startTimeout);
+  size_t nStarted = 0;
+  while (nStarted < bots.size())
+  {
+    nStarted = 0;
+    for (auto &bot : bots)
+    {
+      bot->client.service(0);
+      nStarted += bot->client.start() ? 1 : 0;
+    }
+    if (nStarted < bots.size() && clock::now() >= startDeadline)
+    {
+      printf("Only %zu of %zu clients started in %u s, is w5_server --max-peers large enough?\n",
+             nStarted, bots.size(), startTimeout);
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  printf("%zu clients started\n", bots.size());
+
+  const auto frameDuration = std::chrono::microseconds(1000000 / FPS);
+  const uint32_t nFrames = duration * FPS;
+  static NetStats netStatsStart;
+  static NetStats netStatsEnd;
+  net_stats_collect(netStatsStart);
+  const std::clock_t cpuStart = std::clock();
+  const auto start = clock::now();
+  auto nextFrame = start;
+  for (uint32_t frame = 0; frame < nFrames; ++frame)
+  {
+    for (auto &bot : bots)
+    {
+      const auto updateStart = clock::now();
+      bot->client.service(0);
+      steer_bot(*bot, frame);
+      bot->client.update(bot->thr, bot->steer);
+      bot->updateSeconds += std::chrono::duration<double>(clock::now() - updateStart).count();
+    }
+    nextFrame += frameDuration;
+    std::this_thread::sleep_until(nextFrame);
+  }
+  const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+  const double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+  printf("%-4s %-8s %9s %9s %9s %9s %9s %9s %8s\n",
+         "bot", "pattern", "snaps", "rollbk/s", "rollbk%", "avgDepth", "maxDepth", "earlyOut%", "us/frame");
+  ReconciliationStats total;
+  double totalUpdateSeconds = 0.0;
+  for (size_t i = 0; i < bots.size(); ++i)
+  {
+    const Bot &bot = *bots[i];
+    const ReconciliationStats &stats = bot.client.reconciliationStats();
+    printf("%-4zu %-8s %9u %9.2f %9.2f %9.2f %9u %9.2f %8.1f\n", i, pattern_name(bot.pattern), stats.snapshots,
+           stats.rollbacks / seconds,
+           stats.snapshots > 0 ? 100.0 * stats.rollbacks / stats.snapshots : 0.0,
+           stats.rollbacks > 0 ? double(stats.rollbackDepth) / stats.rollbacks : 0.0,
+           stats.maxRollbackDepth,
+           stats.rollbacks > 0 ? 100.0 * stats.earlyOuts / stats.rollbacks : 0.0,
+           bot.updateSeconds * 1e6 / nFrames);
+    total.snapshots += stats.snapshots;
+    total.rollbacks += stats.rollbacks;
+    total.earlyOuts += stats.earlyOuts;
+    total.rollbackDepth += stats.rollbackDepth;
+    total.maxRollbackDepth = std::max(total.maxRollbackDepth, stats.maxRollbackDepth);
+    total.replayedTicks += stats.replayedTicks;
+    totalUpdateSeconds += bot.updateSeconds;
+  }
+  printf("%zu clients, %.1f s: %.2f rollbacks/s per client, %.2f%% of snapshots corrected, max depth %u, %.1f replayed ticks/s per client\n",
+         bots.size(), seconds, total.rollbacks / seconds / bots.size(),
+         total.snapshots > 0 ? 100.0 * total.rollbacks / total.snapshots : 0.0,
+         total.maxRollbackDepth, total.replayedTicks / seconds / bots.size());
+  printf("cpu: %.1f us per client per frame in netcode, %.2f%% of a core per client (process cpu %.2f s)\n",
+         totalUpdateSeconds * 1e6 / nFrames / bots.size(), 100.0 * cpuSeconds / seconds / bots.size(), cpuSeconds);
+
+  // трафик всех клиентов вместе по типам сообщений за время замера
+  net_stats_collect(netStatsEnd);
+  net_stats_diff(netStatsEnd, netStatsStart, netStatsEnd);
+  net_stats_print_table(stdout, netStatsEnd, seconds, message_type_name);
+
+  bots.clear();
+  atexit(enet_deinitialize);
+  return 0;
+}
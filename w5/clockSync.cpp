@@ -0,0 +1,91 @@
+#include "clockSync.h"
+#include <cmath>
+
+void ClockSync::addSample(uint32_t localSendTime, uint32_t serverTime, uint32_t localReceiveTime)
+{
+  Sample sample;
+  sample.localTime = localReceiveTime;
+  sample.rtt = localReceiveTime - localSendTime;
+  // сервер ставит свое время примерно посередине пути туда-обратно
+  sample.offset = static_cast<double>(serverTime) + sample.rtt * 0.5 - static_cast<double>(localReceiveTime);
+
+  m_samples[m_nextSample] = sample;
+  m_nextSample = (m_nextSample + 1) % SAMPLES_WINDOW;
+  if (m_nSamples < SAMPLES_WINDOW) {
+    ++m_nSamples;
+  }
+
+  if (++m_samplesSinceAnchor >= SAMPLES_WINDOW) {
+    updateDrift(bestSample());
+    m_samplesSinceAnchor = 0;
+  }
+}
+
+void ClockSync::update(uint32_t localTime)
+{
+  if (m_nSamples == 0) {
+    return;
+  }
+  if (!m_offsetSet) {
+    m_offset = estimateOffset(localTime);
+    m_lastUpdate = localTime;
+    m_offsetSet = true;
+    return;
+  }
+  const double error = estimateOffset(localTime) - m_offset;
+  const double maxStep = SLEW_RATE * static_cast<double>(localTime - m_lastUpdate);
+  m_lastUpdate = localTime;
+  if (std::abs(error) > JUMP_THRESHOLD) {
+    m_offset += error;
+  } else {
+    m_offset += error < -maxStep ? -maxStep : error > maxStep ? maxStep : error;
+  }
+}
+
+uint32_t ClockSync::now(uint32_t localTime) const
+{
+  return static_cast<uint32_t>(static_cast<int64_t>(localTime) + std::llround(m_offset));
+}
+
+uint32_t ClockSync::minRoundTripTime() const
+{
+  return m_nSamples == 0 ? 0 : bestSample().rtt;
+}
+
+const ClockSync::Sample& ClockSync::bestSample() const
+{
+  size_t best = 0;
+  for (size_t i = 1; i < m_nSamples; ++i) {
+    if (m_samples[i].rtt < m_samples[best].rtt) {
+      best = i;
+    }
+  }
+  return m_samples[best];
+}
+
+double ClockSync::estimateOffset(uint32_t localTime) const
+{
+  if (m_nSamples == 0) {
+    return m_offset;
+  }
+  const Sample &best = bestSample();
+  const double elapsed = static_cast<double>(static_cast<int32_t>(localTime - best.localTime));
+  return best.offset + m_drift * elapsed;
+}
+
+void ClockSync::updateDrift(const Sample &best)
+{
+  if (!m_hasAnchor) {
+    m_anchor = best;
+    m_hasAnchor = true;
+    return;
+  }
+  const uint32_t interval = best.localTime - m_anchor.localTime;
+  if (interval < MIN_DRIFT_INTERVAL) {
+    return;
+  }
+  double measured = (best.offset - m_anchor.offset) / static_cast<double>(interval);
+  measured = measured < -MAX_DRIFT ? -MAX_DRIFT : measured > MAX_DRIFT ? MAX_DRIFT : measured;
+  m_drift += DRIFT_SMOOTHING * (measured - m_drift);
+  m_anchor = best;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Непрерывная синхронизация часов клиента с сервером в духе NTP.
+// Клиент периодически шлет ping со своим временем, сервер отвечает pong с этим временем и своим.
+// Из последних замеров берется замер с минимальным rtt (у него меньше всего очередей и задержек обработки),
+// по сдвигу лучших замеров между окнами оценивается дрейф локальных часов относительно серверных.
+// Смещение часов не прыгает, а подтягивается к оценке с ограниченной скоростью, поэтому время не идет назад
+// и не рвет локальную симуляцию. Прыжок только при первой синхронизации или при очень большой ошибке.
+class ClockSync
+{
+ public:
+    void addSample(uint32_t localSendTime, uint32_t serverTime, uint32_t localReceiveTime);
+
+    // Подводит текущее смещение к оценке, вызывать раз в кадр. Первый вызов сразу ставит часы по накопленным замерам
+    void update(uint32_t localTime);
+
+    // Оценка серверного времени в момент localTime
+    uint32_t now(uint32_t localTime) const;
+
+    bool isSynced() const { return m_nSamples > 0; }
+    bool isClockSet() const { return m_offsetSet; }
+    size_t samplesCount() const { return m_nSamples; }
+    uint32_t minRoundTripTime() const;
+    double driftPpm() const { return m_drift * 1e6; }
+
+ private:
+    struct Sample
+    {
+        uint32_t localTime;
+        uint32_t rtt;
+        double offset;
+    };
+
+    const Sample& bestSample() const;
+    double estimateOffset(uint32_t localTime) const;
+    void updateDrift(const Sample &best);
+
+    static constexpr size_t SAMPLES_WINDOW = 16;
+    static constexpr double SLEW_RATE = 0.05;           // мс подводки на мс реального времени
+    static constexpr double JUMP_THRESHOLD = 500.0;     // мс, при большей ошибке часы переставляются сразу
+    static constexpr uint32_t MIN_DRIFT_INTERVAL = 10000; // мс между опорными замерами для оценки дрейфа
+    static constexpr double MAX_DRIFT = 0.0005;         // 500 ppm, больше обычные кварцы не уходят
+    static constexpr double DRIFT_SMOOTHING = 0.25;
+
+    std::array<Sample, SAMPLES_WINDOW> m_samples{};
+    size_t m_nSamples = 0;
+    size_t m_nextSample = 0;
+    size_t m_samplesSinceAnchor = 0;
+
+    Sample m_anchor{};
+    bool m_hasAnchor = false;
+    double m_drift = 0.0;
+
+    double m_offset = 0.0;
+    uint32_t m_lastUpdate = 0;
+    bool m_offsetSet = false;
+};
@@ -0,0 +1,110 @@
+// Проверка детерминизма симуляции: прогоняет simulate_entity по заранее записанным вводам
+// и сверяет итоговые entity_state_hash с эталонными значениями.
+// Попутно сверяет потиковую симуляцию одной сущности с пакетной simulate_entities.
+// Использование: w5_determinism [--print]
+//   --print  напечатать посчитанные хеши вместо сверки (для обновления эталонов после осознанного изменения симуляции)
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "entity.h"
+#include "params.h"
+
+struct InputSegment
+{
+  uint32_t ticks;
+  float thr;
+  float steer;
+};
+
+struct Scenario
+{
+  const char *name;
+  float x, y, ori;
+  std::vector<InputSegment> inputs;
+  uint32_t goldenHash;
+};
+
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+static const float INF = std::numeric_limits<float>::infinity();
+
+static const std::vector<Scenario> scenarios = {
+  {"idle", 0.f, 0.f, 0.f, {{100, 0.f, 0.f}}, 0xe2ba14a5u},
+  {"straight", 10.f, -5.f, 0.f, {{250, 1.f, 0.f}}, 0x075a4110u},
+  {"brake", 0.f, 0.f, 1.f, {{100, 1.f, 0.f}, {50, -1.f, 0.f}, {100, 0.f, 0.f}}, 0xf50bf01cu},
+  {"reverse", 0.f, 0.f, -2.f, {{200, -0.3f, 0.5f}}, 0xce3583f8u},
+  {"circle", -100.f, 100.f, 0.f, {{500, 0.7f, 1.f}}, 0xc79318f4u},
+  {"slalom", 0.f, 0.f, 0.f, {{40, 1.f, 1.f}, {40, 1.f, -1.f}, {40, 1.f, 1.f}, {40, 1.f, -1.f}, {40, 0.5f, 0.f}}, 0xc2807c2du},
+  {"partial", 3.25f, 7.5f, 0.3f, {{13, 0.123f, -0.77f}, {77, 0.9f, 0.33f}, {31, -0.05f, 0.f}}, 0x4a850068u},
+  {"long_run", 0.f, 0.f, 0.f, {{3000, 1.f, 0.25f}}, 0xabefbf1bu},
+  // Мусорный ввод от клиента не должен приводить к неопределенному поведению и расхождению
+  {"garbage_input", 0.f, 0.f, 0.f, {{20, NaN, NaN}, {20, INF, -INF}, {20, 1e30f, -1e30f}, {20, 1.f, 0.f}}, 0xc7d6c8c4u},
+  {"far_away", 32000.f, -32000.f, 0.f, {{500, 1.f, 0.f}}, 0x82307fd8u},
+};
+
+// Возвращает false, если потиковая и пакетная симуляции разошлись
+static bool run_scenario(const Scenario &scenario, uint32_t &hash)
+{
+  constexpr float dt = fixedDt * 0.001f;
+  Entity e;
+  e.x = scenario.x;
+  e.y = scenario.y;
+  e.ori = scenario.ori;
+
+  EntitiesState batch;
+  batch.push_back(e);
+
+  bool consistent = true;
+  for (const InputSegment &segment : scenario.inputs)
+  {
+    for (uint32_t i = 0; i < segment.ticks; ++i)
+    {
+      e.thr = segment.thr;
+      e.steer = segment.steer;
+      batch.thr[0] = segment.thr;
+      batch.steer[0] = segment.steer;
+      simulate_entity(e, dt);
+      simulate_entities(batch, dt);
+      ++e.tick;
+
+      Entity fromBatch = e;
+      batch.load(0, fromBatch);
+      if (entity_state_hash(fromBatch) != entity_state_hash(e))
+        consistent = false;
+    }
+  }
+  hash = entity_state_hash(e);
+  return consistent;
+}
+
+int main(int argc, const char **argv)
+{
+  const bool print = argc > 1 && strcmp(argv[1], "--print") == 0;
+
+  uint32_t failed = 0;
+  for (const Scenario &scenario : scenarios)
+  {
+    uint32_t hash = 0;
+    const bool consistent = run_scenario(scenario, hash);
+    if (print)
+    {
+      printf("%-16s 0x%08xu\n", scenario.name, hash);
+      continue;
+    }
+    const bool ok = consistent && hash == scenario.goldenHash;
+    if (!ok)
+      ++failed;
+    printf("%-16s %s", scenario.name, ok ? "ok" : "FAILED");
+    if (!consistent)
+      printf(" (simulate_entity and simulate_entities diverged)");
+    if (hash != scenario.goldenHash)
+      printf(" (hash 0x%08x, expected 0x%08x)", hash, scenario.goldenHash);
+    printf("\n");
+  }
+
+  if (print)
+    return 0;
+  printf("%zu scenarios, %u failed\n", scenarios.size(), failed);
+  return failed == 0 ? 0 : 1;
+}
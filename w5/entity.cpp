@@ -1,14 +1,107 @@
 #include "entity.h"
 #include "mathUtils.h"
+#include "fixedMath.h"
+#include "slotMap.h"
+#include <cstring> // memcpy
+
+// Один тик симуляции. Состояние хранится во float, но считается целиком в фиксированной точке,
+// поэтому клиентское предсказание и сервер получают бит в бит одинаковый результат на любой сборке
+static inline void simulate_fixed(float &x, float &y, float &speed, float &ori, float thr, float steer, fixed dt)
+{
+  constexpr fixed MIN_THR = -19661;     // -0.3
+  constexpr fixed STEER_FACTOR = 19661; // 0.3
+  const fixed fThr = fx_from_float(thr);
+  const fixed fSteer = fx_from_float(steer);
+  fixed fSpeed = fx_from_float(speed);
+  fixed fOri = fx_from_float(ori);
+  fixed fX = fx_from_float(x);
+  fixed fY = fx_from_float(y);
+
+  const bool isBraking = fx_sign(fThr) != 0 && fx_sign(fThr) != fx_sign(fSpeed);
+  const fixed accel = fx_from_int(isBraking ? 12 : 3);
+  fSpeed = fx_move_to(fSpeed, fx_clamp(fThr, MIN_THR, FIXED_ONE) * 10, fx_mul(accel, dt));
+  fOri += fx_mul(fx_mul(fx_mul(fSteer, dt), fx_clamp(fSpeed, fx_from_int(-2), fx_from_int(2))), STEER_FACTOR);
+  const fixed step = fx_mul(fSpeed, dt);
+  fX += fx_mul(fx_cos(fOri), step);
+  fY += fx_mul(fx_sin(fOri), step);
+
+  speed = fx_to_float(fSpeed);
+  ori = fx_to_float(fOri);
+  x = fx_to_float(fX);
+  y = fx_to_float(fY);
+}
 
 void simulate_entity(Entity &e, float dt)
 {
-  bool isBraking = sign(e.thr) != 0.f && sign(e.thr) != sign(e.speed);
-  float accel = isBraking ? 12.f : 3.f;
-  e.speed = move_to(e.speed, clamp(e.thr, -0.3, 1.f) * 10.f, dt, accel);
-  e.ori += e.steer * dt * clamp(e.speed, -2.f, 2.f) * 0.3f;
-  e.x += cosf(e.ori) * e.speed * dt;
-  e.y += sinf(e.ori) * e.speed * dt;
+  simulate_fixed(e.x, e.y, e.speed, e.ori, e.thr, e.steer, fx_from_float(dt));
+}
+
+// Та же симуляция, что и в simulate_entity, одним проходом по плоским массивам всех сущностей.
+// Внутри только целочисленная арифметика без вызовов libm, поэтому цикл хорошо ложится в кеш и векторизуется компилятором
+void simulate_entities(EntitiesState &state, float dt)
+{
+  const fixed fDt = fx_from_float(dt);
+  const size_t n = state.size();
+  float *x = state.x.data();
+  float *y = state.y.data();
+  float *speed = state.speed.data();
+  float *ori = state.ori.data();
+  const float *thr = state.thr.data();
+  const float *steer = state.steer.data();
+  for (size_t i = 0; i < n; ++i)
+  {
+    simulate_fixed(x[i], y[i], speed[i], ori[i], thr[i], steer[i], fDt);
+  }
+}
+
+uint32_t entity_state_hash(const Entity &e)
+{
+  // FNV-1a по битам полей, влияющих на симуляцию
+  const float fields[] = {e.x, e.y, e.speed, e.ori, e.thr, e.steer};
+  uint8_t bytes[sizeof(fields)];
+  memcpy(bytes, fields, sizeof(fields));
+  uint32_t hash = 2166136261u;
+  for (uint8_t byte : bytes)
+  {
+    hash ^= byte;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void EntitiesState::push_back(const Entity &e)
+{
+  x.push_back(e.x);
+  y.push_back(e.y);
+  speed.push_back(e.speed);
+  ori.push_back(e.ori);
+  thr.push_back(e.thr);
+  steer.push_back(e.steer);
+}
+
+void EntitiesState::swapRemove(size_t i)
+{
+  for (std::vector<float> *v : {&x, &y, &speed, &ori, &thr, &steer})
+    swap_remove(*v, i);
+}
+
+void EntitiesState::load(size_t i, Entity &e) const
+{
+  e.x = x[i];
+  e.y = y[i];
+  e.speed = speed[i];
+  e.ori = ori[i];
+  e.thr = thr[i];
+  e.steer = steer[i];
+}
+
+EntityVelocity entity_velocity(const Entity &e)
+{
+  EntityVelocity v;
+  v.vx = cosf(e.ori) * e.speed;
+  v.vy = sinf(e.ori) * e.speed;
+  v.angVel = e.steer * clamp(e.speed, -2.f, 2.f) * 0.3f;
+  return v;
 }
 
 void simulate_entity_cheat(Entity &e, float dt)
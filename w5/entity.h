@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <vector>
 
 constexpr uint16_t invalid_entity = -1;
 struct Entity
@@ -18,6 +20,37 @@ struct Entity
   uint16_t eid = invalid_entity;
 };
 
+// Скорость сущности в мире: для интерполяции на клиенте, в симуляции не участвует
+struct EntityVelocity
+{
+  float vx = 0.f;
+  float vy = 0.f;
+  float angVel = 0.f; // рад/с
+};
+
+// Состояние всех сущностей мира в виде SoA: симуляция тика идет одним проходом по массивам
+struct EntitiesState
+{
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> speed;
+  std::vector<float> ori;
+  std::vector<float> thr;
+  std::vector<float> steer;
+
+  size_t size() const { return x.size(); }
+  void push_back(const Entity &e);
+  void load(size_t i, Entity &e) const;
+  void swapRemove(size_t i);
+};
+
 void simulate_entity(Entity &e, float dt);
+void simulate_entities(EntitiesState &state, float dt);
+
+// Симуляция детерминирована, поэтому для сверки состояний достаточно сравнить хеши
+uint32_t entity_state_hash(const Entity &e);
+
+// Скорость, с которой сущность движется в этом состоянии (те же формулы, что в simulate_entity, но во float)
+EntityVelocity entity_velocity(const Entity &e);
 
 void simulate_entity_cheat(Entity &e, float dt);
\ No newline at end of file
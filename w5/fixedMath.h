@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <cstring> // memcpy
+
+// Детерминированная арифметика с фиксированной точкой Q16.16 для симуляции.
+// Только целочисленные операции и однозначно определенные IEEE преобразования float <-> int,
+// поэтому результат бит в бит совпадает на любом компиляторе, libm и уровне оптимизаций, включая -ffast-math.
+// Преобразования детерминированы, но не всегда точны: float хранит 24 бита мантиссы,
+// и fx_to_float округляет значения с |x| >= 256.
+typedef int32_t fixed;
+
+constexpr int FIXED_FRACTION_BITS = 16;
+constexpr fixed FIXED_ONE = 1 << FIXED_FRACTION_BITS;
+constexpr float FIXED_MAX_FLOAT = 32767.f;
+
+constexpr fixed fx_from_int(int32_t v) { return v * FIXED_ONE; }
+
+// Отбрасывание дробной части при преобразовании float -> int определено стандартом одинаково везде,
+// но только для значений, попадающих в int32: NaN и бесконечности до преобразования не доходят.
+// Их ищем по битам, а не сравнениями: с -ffast-math компилятор считает, что их не бывает, и выкидывает v != v
+inline fixed fx_from_float(float v)
+{
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  if ((bits & 0x7f800000u) == 0x7f800000u) // экспонента из одних единиц
+  {
+    if (bits & 0x007fffffu) // NaN
+      return 0;
+    v = bits & 0x80000000u ? -FIXED_MAX_FLOAT : FIXED_MAX_FLOAT;
+  }
+  v = v < -FIXED_MAX_FLOAT ? -FIXED_MAX_FLOAT : v > FIXED_MAX_FLOAT ? FIXED_MAX_FLOAT : v;
+  return static_cast<fixed>(v * static_cast<float>(FIXED_ONE));
+}
+
+inline float fx_to_float(fixed v)
+{
+  return static_cast<float>(v) / static_cast<float>(FIXED_ONE);
+}
+
+constexpr fixed fx_mul(fixed a, fixed b)
+{
+  return static_cast<fixed>((static_cast<int64_t>(a) * b) >> FIXED_FRACTION_BITS);
+}
+
+constexpr fixed fx_abs(fixed v) { return v < 0 ? -v : v; }
+constexpr fixed fx_sign(fixed v) { return v > 0 ? FIXED_ONE : v < 0 ? -FIXED_ONE : 0; }
+constexpr fixed fx_clamp(fixed v, fixed lo, fixed hi) { return v < lo ? lo : v > hi ? hi : v; }
+
+constexpr fixed fx_move_to(fixed from, fixed to, fixed d)
+{
+  return fx_abs(from - to) < d ? to : to < from ? from - d : from + d;
+}
+
+// Угол в единицах 1/65536 оборота
+constexpr uint32_t FIXED_ANGLE_QUARTER = 1 << 14;
+
+// Перевод радиан в доли оборота: 1/(2*PI) в Q32
+constexpr int64_t FIXED_INV_TWO_PI_Q32 = 683565276;
+
+constexpr uint32_t fx_radians_to_angle(fixed radians)
+{
+  return static_cast<uint32_t>((static_cast<int64_t>(radians) * FIXED_INV_TWO_PI_Q32) >> 32) & 0xffff;
+}
+
+// sin(PI/2 * z) ~ z * (A - z^2 * (B - z^2 * C)) на четверти периода, минимаксные коэффициенты, ошибка около 1e-4
+constexpr fixed fx_sin_angle(uint32_t angle)
+{
+  constexpr int64_t A = 102930; // 1.5705946
+  constexpr int64_t B = 42139;  // 0.6429975
+  constexpr int64_t C = 4751;   // 0.0724949
+  const uint32_t quadrant = (angle >> 14) & 3;
+  uint32_t z = angle & (FIXED_ANGLE_QUARTER - 1);
+  if (quadrant & 1) {
+    z = FIXED_ANGLE_QUARTER - z;
+  }
+  const int64_t zq = static_cast<int64_t>(z) << 2; // Q16
+  const int64_t z2 = (zq * zq) >> 16;
+  const int64_t r = (zq * (A - ((z2 * (B - ((z2 * C) >> 16))) >> 16))) >> 16;
+  return static_cast<fixed>(quadrant & 2 ? -r : r);
+}
+
+constexpr fixed fx_sin(fixed radians) { return fx_sin_angle(fx_radians_to_angle(radians)); }
+constexpr fixed fx_cos(fixed radians) { return fx_sin_angle(fx_radians_to_angle(radians) + FIXED_ANGLE_QUARTER); }
@@ -0,0 +1,57 @@
+#include "fuzzDriver.h"
+#include "protocol.h"
+#include <vector>
+
+void fuzz_deserialize(ENetPacket *packet)
+{
+  switch (get_packet_type(packet))
+  {
+  case E_CLIENT_TO_SERVER_JOIN:
+    break;
+  case E_SERVER_TO_CLIENT_NEW_ENTITY:
+    {
+      Entity ent;
+      deserialize_new_entity(packet, ent);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY:
+    {
+      uint16_t eid = invalid_entity;
+      deserialize_set_controlled_entity(packet, eid);
+    }
+    break;
+  case E_CLIENT_TO_SERVER_INPUT:
+    {
+      // между вызовами живет, как у сервера, чтобы замер не мерил выделение памяти
+      static std::vector<EntityInputRun> runs;
+      uint16_t eid = invalid_entity;
+      deserialize_entity_input(packet, eid, runs);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SNAPSHOT:
+    {
+      Entity ent;
+      EntityVelocity velocity;
+      deserialize_snapshot(packet, ent, velocity);
+    }
+    break;
+  case E_CLIENT_TO_SERVER_TIME_PING:
+    {
+      uint32_t clientTime = 0;
+      deserialize_time_ping(packet, clientTime);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_TIME_PONG:
+    {
+      uint32_t clientTime = 0; uint32_t serverTime = 0;
+      deserialize_time_pong(packet, clientTime, serverTime);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_REMOVE_ENTITY:
+    {
+      uint16_t eid = invalid_entity;
+      deserialize_remove_entity(packet, eid);
+    }
+    break;
+  }
+}
@@ -0,0 +1,69 @@
+#include "interpolation.h"
+#include "params.h"
+#include <algorithm>
+#include "slotMap.h"
+
+void HermiteSamples::resize(size_t n)
+{
+  startTime.resize(n);
+  durationMs.resize(n);
+  duration.resize(n);
+  invDuration.resize(n);
+  for (std::vector<float> *v : {&x0, &y0, &ori0, &vx0, &vy0, &angVel0, &x1, &y1, &ori1, &vx1, &vy1, &angVel1})
+    v->resize(n);
+}
+
+void HermiteSamples::swapRemove(size_t i)
+{
+  swap_remove(startTime, i);
+  swap_remove(durationMs, i);
+  swap_remove(duration, i);
+  swap_remove(invDuration, i);
+  for (std::vector<float> *v : {&x0, &y0, &ori0, &vx0, &vy0, &angVel0, &x1, &y1, &ori1, &vx1, &vy1, &angVel1})
+    swap_remove(*v, i);
+}
+
+void HermiteSamples::set(size_t i, const Entity &e0, const EntityVelocity &v0, const Entity &e1, const EntityVelocity &v1)
+{
+  const uint32_t t0 = e0.tick * fixedDt;
+  const uint32_t t1 = e1.tick * fixedDt;
+  startTime[i] = t0;
+  durationMs[i] = t1 > t0 ? static_cast<int32_t>(t1 - t0) : 0;
+  duration[i] = t1 > t0 ? (t1 - t0) * 0.001f : 0.f;
+  invDuration[i] = t1 > t0 ? 1.f / (t1 - t0) : 0.f;
+  x0[i] = e0.x; y0[i] = e0.y; ori0[i] = e0.ori;
+  vx0[i] = v0.vx; vy0[i] = v0.vy; angVel0[i] = v0.angVel;
+  x1[i] = e1.x; y1[i] = e1.y; ori1[i] = e1.ori;
+  vx1[i] = v1.vx; vy1[i] = v1.vy; angVel1[i] = v1.angVel;
+}
+
+void hermite_interpolate(const HermiteSamples &samples, size_t begin, size_t end, uint32_t time,
+                         float *__restrict x, float *__restrict y, float *__restrict ori)
+{
+  const uint32_t *startTime = samples.startTime.data();
+  const int32_t *durationMs = samples.durationMs.data();
+  const float *duration = samples.duration.data();
+  const float *invDuration = samples.invDuration.data();
+  const float *x0 = samples.x0.data(), *y0 = samples.y0.data(), *ori0 = samples.ori0.data();
+  const float *vx0 = samples.vx0.data(), *vy0 = samples.vy0.data(), *angVel0 = samples.angVel0.data();
+  const float *x1 = samples.x1.data(), *y1 = samples.y1.data(), *ori1 = samples.ori1.data();
+  const float *vx1 = samples.vx1.data(), *vy1 = samples.vy1.data(), *angVel1 = samples.angVel1.data();
+  for (size_t i = begin; i < end; ++i)
+  {
+    // разность по модулю 2^32, поэтому переполнение часов не мешает.
+    // Ограничение по отрезку в целых: сравнения float без -ffast-math мешают векторизации
+    const int32_t elapsed = static_cast<int32_t>(time - startTime[i]);
+    const int32_t clamped = std::min(std::max(elapsed, 0), durationMs[i]);
+    const float t = static_cast<float>(clamped) * invDuration[i];
+    const float extrapolation = static_cast<float>(std::max(elapsed - durationMs[i], 0)) * 0.001f;
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    const float h00 = 2.f * t3 - 3.f * t2 + 1.f;
+    const float h10 = (t3 - 2.f * t2 + t) * duration[i];
+    const float h01 = -2.f * t3 + 3.f * t2;
+    const float h11 = (t3 - t2) * duration[i] + extrapolation;
+    x[i]   = h00 * x0[i] + h10 * vx0[i] + h01 * x1[i] + h11 * vx1[i];
+    y[i]   = h00 * y0[i] + h10 * vy0[i] + h01 * y1[i] + h11 * vy1[i];
+    ori[i] = h00 * ori0[i] + h10 * angVel0[i] + h01 * ori1[i] + h11 * angVel1[i];
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "entity.h"
+
+// Пары соседних снепшотов всех интерполируемых сущностей в виде SoA.
+// Между двумя снепшотами положение и угол восстанавливаются кубическим сплайном Эрмита по значениям и скоростям на концах:
+// в отличие от параболы по трем точкам он не выбегает за траекторию и не требует третьего снепшота
+struct HermiteSamples
+{
+  std::vector<uint32_t> startTime; // мс, время первого снепшота
+  std::vector<int32_t> durationMs; // между снепшотами
+  std::vector<float> duration;     // то же в секундах
+  std::vector<float> invDuration;  // 1/мс, 0 если снепшоты на одном тике
+  std::vector<float> x0, y0, ori0, vx0, vy0, angVel0;
+  std::vector<float> x1, y1, ori1, vx1, vy1, angVel1;
+
+  size_t size() const { return startTime.size(); }
+  void resize(size_t n);
+  void swapRemove(size_t i);
+  void set(size_t i, const Entity &e0, const EntityVelocity &v0, const Entity &e1, const EntityVelocity &v1);
+};
+
+// Положения сущностей [begin, end) на момент time (мс). Один проход без ветвлений по плоским массивам, векторизуется компилятором
+// (выходные массивы не должны пересекаться с samples, иначе проверок на пересечение слишком много для векторизации).
+// После второго снепшота сущность продолжает движение по прямой с его скоростью
+void hermite_interpolate(const HermiteSamples &samples, size_t begin, size_t end, uint32_t time,
+                         float *__restrict x, float *__restrict y, float *__restrict ori);
@@ -0,0 +1,76 @@
+#include "jitterBuffer.h"
+#include "params.h"
+#include <algorithm>
+
+void JitterBuffer::onSnapshot(uint16_t eid, uint32_t snapshotTime, uint32_t arrivalTime)
+{
+  // пачка прошлого тика закончилась, ее худший замер идет в окно
+  if (snapshotTime != m_batchTime && m_batchHasSample) {
+    addDelaySample(m_batchDelay);
+    m_batchHasSample = false;
+  }
+  m_batchTime = snapshotTime;
+
+  auto [last, isNew] = m_lastSnapshotTime.try_emplace(eid, snapshotTime);
+  if (isNew || snapshotTime <= last->second) {
+    return; // первый снепшот сущности или опоздавший unsequenced
+  }
+  const int32_t delay = static_cast<int32_t>(arrivalTime - last->second);
+  m_batchDelay = m_batchHasSample ? std::max(m_batchDelay, delay) : delay;
+  m_batchHasSample = true;
+  last->second = snapshotTime;
+}
+
+void JitterBuffer::addDelaySample(int32_t delay)
+{
+  m_delaySamples[m_nextDelaySample] = delay;
+  m_nextDelaySample = (m_nextDelaySample + 1) % DELAY_WINDOW;
+  m_nDelaySamples = std::min(m_nDelaySamples + 1, DELAY_WINDOW);
+
+  std::array<int32_t, DELAY_WINDOW> sorted = m_delaySamples;
+  const size_t quantileIndex = std::min(static_cast<size_t>(m_nDelaySamples * (1.0 - TARGET_UNDERRUN_RATE)),
+                                        m_nDelaySamples - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + quantileIndex, sorted.begin() + m_nDelaySamples);
+  m_delayQuantile = std::max(sorted[quantileIndex], 0);
+}
+
+void JitterBuffer::onFrame(bool underrun)
+{
+  ++m_frames;
+  m_underruns += underrun ? 1 : 0;
+  if (m_frames < UNDERRUN_WINDOW) {
+    return;
+  }
+  const double underrunRate = static_cast<double>(m_underruns) / m_frames;
+  if (underrunRate > TARGET_UNDERRUN_RATE) {
+    m_margin += MARGIN_STEP;
+  } else if (m_underruns == 0) {
+    m_margin = std::max(m_margin - MARGIN_DECAY, 0.0);
+  }
+  m_frames = 0;
+  m_underruns = 0;
+}
+
+uint32_t JitterBuffer::targetDelay() const
+{
+  // пока замеров нет - с запасом на самый редкий обычный снепшот
+  if (m_nDelaySamples == 0) {
+    return SEND_TIMEOUT + FIXED_OFFSET;
+  }
+  return static_cast<uint32_t>(m_delayQuantile) + static_cast<uint32_t>(m_margin);
+}
+
+uint32_t JitterBuffer::renderTime(uint32_t serverTime)
+{
+  const double target = targetDelay();
+  if (!m_started) {
+    m_delay = target;
+    m_started = true;
+  } else {
+    // воспроизведение идет со скоростью 1 +- PLAYBACK_RATE_DEVIATION, пока задержка не сойдется к целевой
+    const double maxStep = PLAYBACK_RATE_DEVIATION * static_cast<double>(serverTime - m_lastServerTime);
+    m_delay += std::clamp(target - m_delay, -maxStep, maxStep);
+  }
+  m_lastServerTime = serverTime;
+  return serverTime - static_cast<uint32_t>(m_delay);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// Адаптивная задержка отрисовки удаленных сущностей для одного соединения.
+// Чтобы интерполировать сущность, к моменту отрисовки должен прийти ее следующий снепшот, поэтому для каждого
+// снепшота замеряется, какая задержка его бы дождалась: приход (по синхронизированным часам) минус время
+// предыдущего снепшота той же сущности. Это интервал между снепшотами сущности, который у планировщика сервера
+// свой для каждого пира и сущности, плюс время в пути вместе с его разбросом. Недостача в кадре - это недостача
+// хотя бы у одной сущности, поэтому из пачки снепшотов одного тика берется худший замер.
+// Задержка = квантиль замеров, при котором опоздавших снепшотов не больше целевой доли,
+// плюс запас, который растет, если кадры все равно остаются без будущего снепшота, и медленно тает, если нет.
+// К новой задержке воспроизведение подходит плавно, чуть ускоряясь или замедляясь, без скачков назад.
+class JitterBuffer
+{
+ public:
+    // Снепшот удаленной сущности eid (свою сущность клиент предсказывает, ее снепшоты сюда не идут)
+    void onSnapshot(uint16_t eid, uint32_t snapshotTime, uint32_t arrivalTime);
+    void removeEntity(uint16_t eid) { m_lastSnapshotTime.erase(eid); }
+
+    // underrun - в этом кадре хотя бы одной сущности не хватило будущего снепшота
+    void onFrame(bool underrun);
+
+    // Время в прошлом (по часам сервера), на которое надо интерполировать удаленные сущности
+    uint32_t renderTime(uint32_t serverTime);
+
+    uint32_t delay() const { return static_cast<uint32_t>(m_delay); }
+    uint32_t targetDelay() const;
+
+ private:
+    static constexpr size_t DELAY_WINDOW = 128;         // пачек, ~2.5 секунды при снепшотах каждый тик
+    static constexpr double TARGET_UNDERRUN_RATE = 0.01;
+    static constexpr size_t UNDERRUN_WINDOW = 300;     // кадров, ~5 секунд
+    static constexpr double MARGIN_STEP = 10.0;        // мс
+    static constexpr double MARGIN_DECAY = 1.0;        // мс за окно без недостач
+    static constexpr double PLAYBACK_RATE_DEVIATION = 0.05;
+
+    void addDelaySample(int32_t delay);
+
+    std::unordered_map<uint16_t, uint32_t> m_lastSnapshotTime; // eid -> время последнего снепшота
+    uint32_t m_batchTime = 0;
+    int32_t m_batchDelay = 0;
+    bool m_batchHasSample = false;
+
+    std::array<int32_t, DELAY_WINDOW> m_delaySamples{};
+    size_t m_nDelaySamples = 0;
+    size_t m_nextDelaySample = 0;
+    int32_t m_delayQuantile = 0;
+
+    size_t m_frames = 0;
+    size_t m_underruns = 0;
+    double m_margin = 0.0;
+
+    double m_delay = 0.0;
+    uint32_t m_lastServerTime = 0;
+    bool m_started = false;
+};
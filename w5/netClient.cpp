@@ -0,0 +1,470 @@
+#include "netClient.h"
+#include "netStats.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <stdio.h>
+
+NetClient::~NetClient()
+{
+  if (m_networkThread.joinable()) {
+    m_networkRunning = false;
+    m_networkThread.join();
+  }
+  NetworkEvent event;
+  while (m_incoming.tryPop(event)) {
+    if (event.packet) {
+      enet_packet_destroy(event.packet);
+    }
+  }
+  if (m_host) {
+    enet_host_destroy(m_host);
+  }
+}
+
+bool NetClient::connect(const char *host, uint16_t port, bool networkThread)
+{
+  m_host = enet_host_create(nullptr, 1, 2, 0, 0);
+  if (!m_host)
+  {
+    printf("Cannot create ENet client\n");
+    return false;
+  }
+
+  ENetAddress address;
+  enet_address_set_host(&address, host);
+  address.port = port;
+
+  m_serverPeer = enet_host_connect(m_host, &address, 2, 0);
+  if (!m_serverPeer)
+  {
+    printf("Cannot connect to server");
+    return false;
+  }
+  if (networkThread) {
+    m_networkRunning = true;
+    m_networkThread = std::thread(&NetClient::networkLoop, this);
+  }
+  return true;
+}
+
+// Сетевой поток: единственный, кто трогает m_host после connect
+void NetClient::networkLoop()
+{
+  while (m_networkRunning)
+  {
+    NetworkCommand command;
+    while (m_outgoing.tryPop(command)) {
+      execute(command);
+    }
+
+    ENetEvent event;
+    int hasEvent = enet_host_service(m_host, &event, 1);
+    while (hasEvent > 0)
+    {
+      if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
+      }
+      if (event.type == ENET_EVENT_TYPE_CONNECT || event.type == ENET_EVENT_TYPE_RECEIVE) {
+        NetworkEvent networkEvent;
+        networkEvent.type = event.type;
+        networkEvent.packet = event.type == ENET_EVENT_TYPE_RECEIVE ? event.packet : nullptr;
+        networkEvent.arrivalTime = enet_time_get();
+        // пакеты надежного канала терять нельзя, поэтому при полной очереди сетевой поток ждет, а не поток кадра
+        while (!m_incoming.tryPush(networkEvent) && m_networkRunning) {
+          std::this_thread::yield();
+        }
+      }
+      hasEvent = enet_host_check_events(m_host, &event);
+    }
+  }
+}
+
+void NetClient::service(uint32_t timeout)
+{
+  if (m_networkThread.joinable()) {
+    NetworkEvent event;
+    bool any = false;
+    while (m_incoming.tryPop(event)) {
+      handleEvent(event);
+      any = true;
+    }
+    if (!any && timeout > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+    }
+    return;
+  }
+  ENetEvent event;
+  while (enet_host_service(m_host, &event, timeout) > 0)
+  {
+    if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+      net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
+    }
+    if (event.type == ENET_EVENT_TYPE_CONNECT || event.type == ENET_EVENT_TYPE_RECEIVE) {
+      NetworkEvent networkEvent;
+      networkEvent.type = event.type;
+      networkEvent.packet = event.type == ENET_EVENT_TYPE_RECEIVE ? event.packet : nullptr;
+      networkEvent.arrivalTime = enet_time_get();
+      handleEvent(networkEvent);
+    }
+  }
+}
+
+void NetClient::handleEvent(const NetworkEvent &event)
+{
+  switch (event.type)
+  {
+  case ENET_EVENT_TYPE_CONNECT:
+    m_connected = true;
+    send(NetworkCommand{E_COMMAND_JOIN});
+    break;
+  case ENET_EVENT_TYPE_RECEIVE:
+    switch (get_packet_type(event.packet))
+    {
+    case E_SERVER_TO_CLIENT_NEW_ENTITY:
+      onNewEntity(event.packet);
+      break;
+    case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY:
+      onSetControlledEntity(event.packet);
+      break;
+    case E_SERVER_TO_CLIENT_SNAPSHOT:
+      onSnapshot(event.packet, event.arrivalTime);
+      break;
+    case E_SERVER_TO_CLIENT_TIME_PONG:
+      onTimePong(event.packet, event.arrivalTime);
+      break;
+    case E_SERVER_TO_CLIENT_REMOVE_ENTITY:
+      onRemoveEntity(event.packet);
+      break;
+    };
+    enet_packet_destroy(event.packet);
+    break;
+  default:
+    break;
+  };
+}
+
+void NetClient::send(const NetworkCommand &command)
+{
+  if (!m_networkThread.joinable()) {
+    execute(command);
+  } else if (!m_outgoing.tryPush(command)) {
+    ++m_droppedCommands;
+  }
+}
+
+void NetClient::execute(const NetworkCommand &command)
+{
+  switch (command.type)
+  {
+  case E_COMMAND_JOIN:
+    send_join(m_serverPeer);
+    break;
+  case E_COMMAND_TIME_PING:
+    send_time_ping(m_serverPeer, enet_time_get());
+    break;
+  case E_COMMAND_INPUT:
+    send_entity_input(m_serverPeer, command.eid, command.tick, command.inputs, command.count);
+    break;
+  };
+}
+
+bool NetClient::start()
+{
+  if (m_started) {
+    return true;
+  }
+  if (m_clockSync.samplesCount() < INITIAL_CLOCK_SAMPLES || m_localHistory.empty()) {
+    if (m_connected) {
+      pingServerTime(INITIAL_CLOCK_SYNC_INTERVAL);
+    }
+    return false;
+  }
+  m_clockSync.update(enet_time_get());
+  // локальная симуляция продолжается с тика, на котором сервер прислал состояние своей сущности
+  m_currentTick = m_localHistory.backTick();
+  m_lastSync = m_currentTick;
+  m_started = true;
+  return true;
+}
+
+void NetClient::update(float thr, float steer)
+{
+  pingServerTime(CLOCK_SYNC_INTERVAL);
+  m_clockSync.update(enet_time_get());
+  const uint32_t curTime = getGameTime();
+
+  // Интерполяция позиций остальных игроков
+  const uint32_t renderTime = m_jitterBuffer.renderTime(curTime - CLOCK_LEAD);
+  bool underrun = false;
+  for (size_t i = 0; i < m_entities.size(); ++i) {
+    if (m_entities[i].eid != m_myEntity) {
+      underrun |= !setCorrectSnapshotInterval(i, renderTime);
+    }
+  }
+  // своя сущность тоже попадает в общий проход, но сразу перезаписывается ниже
+  interpolateEntities(0, m_entities.size(), renderTime);
+
+  size_t myEntityIndex;
+  if (m_entityIds.find(m_myEntity, myEntityIndex))
+  {
+    const uint32_t curTimeTick = (curTime / fixedDt) + 1;
+    if (m_currentTick < curTimeTick) {
+      sendInput(curTimeTick, thr, steer);
+    }
+    // Локальная симмуляция
+    simulateLocal(curTime, thr, steer);
+    adjustHistory();
+    setCorrectLocalHistoryInterval(myEntityIndex, curTime);
+    interpolateEntities(myEntityIndex, myEntityIndex + 1, curTime);
+  }
+  m_jitterBuffer.onFrame(underrun);
+}
+
+void NetClient::onNewEntity(ENetPacket *packet)
+{
+  Entity newEntity;
+  if (!deserialize_new_entity(packet, newEntity)) {
+    return;
+  }
+  if (!m_entityIds.insert(newEntity.eid)) {
+    return; // don't need to do anything, we already have entity
+  }
+  m_entities.push_back(newEntity);
+  m_entitiesInPast.push_back({newEntity, EntityVelocity()});
+  m_snapshotsHistory.emplace_back();
+  m_snapshotsHistory.back().insert(newEntity.tick, {newEntity, EntityVelocity()});
+  m_interpolationSamples.resize(m_entities.size());
+  m_interpolatedX.resize(m_entities.size());
+  m_interpolatedY.resize(m_entities.size());
+  m_interpolatedOri.resize(m_entities.size());
+  if (newEntity.eid == m_myEntity) {
+    m_localHistory.insert(newEntity.tick, newEntity);
+  }
+}
+
+void NetClient::onRemoveEntity(ENetPacket *packet)
+{
+  uint16_t eid = invalid_entity;
+  if (!deserialize_remove_entity(packet, eid)) {
+    return;
+  }
+  size_t index;
+  m_jitterBuffer.removeEntity(eid);
+  if (!m_entityIds.erase(eid, index)) {
+    return;
+  }
+  swap_remove(m_entities, index);
+  swap_remove(m_entitiesInPast, index);
+  swap_remove(m_snapshotsHistory, index);
+  m_interpolationSamples.swapRemove(index);
+  m_interpolatedX.resize(m_entities.size());
+  m_interpolatedY.resize(m_entities.size());
+  m_interpolatedOri.resize(m_entities.size());
+}
+
+void NetClient::onSetControlledEntity(ENetPacket *packet)
+{
+  if (!deserialize_set_controlled_entity(packet, m_myEntity)) {
+    return;
+  }
+  size_t index;
+  if (m_entityIds.find(m_myEntity, index)) {
+    const Entity &e = m_entities[index];
+    m_localHistory.insert(e.tick, e);
+  }
+}
+
+void NetClient::onSnapshot(ENetPacket *packet, uint32_t arrivalTime)
+{
+  Entity e;
+  EntityVelocity velocity;
+  if (!deserialize_snapshot(packet, e, velocity)) {
+    return;
+  }
+  if (m_clockSync.isClockSet() && e.eid != m_myEntity) {
+    m_jitterBuffer.onSnapshot(e.eid, e.tick * fixedDt, m_clockSync.now(arrivalTime));
+  }
+  if (e.eid == m_myEntity) {
+    ++m_reconciliationStats.snapshots;
+    if (!m_hasMyEntitySnapshot || e.tick > m_lastMyEntitySnapshot.tick) {
+      m_reconciliationStats.coalesced += m_hasMyEntitySnapshot ? 1 : 0;
+      m_lastMyEntitySnapshot = e;
+      m_hasMyEntitySnapshot = true;
+    } else {
+      ++m_reconciliationStats.coalesced;
+    }
+  } else {
+    size_t index;
+    if (!m_entityIds.find(e.eid, index)) {
+      return; // снепшот обогнал сообщение о новой сущности или пришел после удаления
+    }
+    auto &snapshots = m_snapshotsHistory[index];
+    if (!snapshots.empty() && e.tick < snapshots.frontTick()) {
+      return; // unsequenced снепшот опоздал, интерполяция уже ушла дальше
+    }
+    snapshots.insert(e.tick, {e, velocity});
+  }
+}
+
+void NetClient::onTimePong(ENetPacket *packet, uint32_t arrivalTime)
+{
+  uint32_t clientTime, serverTime;
+  if (!deserialize_time_pong(packet, clientTime, serverTime)) {
+    return;
+  }
+  m_clockSync.addSample(clientTime, serverTime, arrivalTime);
+}
+
+void NetClient::pingServerTime(uint32_t interval)
+{
+  const uint32_t localTime = enet_time_get();
+  if (localTime - m_lastPingTime >= interval) {
+    send(NetworkCommand{E_COMMAND_TIME_PING});
+    m_lastPingTime = localTime;
+  }
+}
+
+// Игровое время клиента: оценка серверного времени плюс упреждение, чтобы ввод успевал дойти до сервера к своему тику
+uint32_t NetClient::getGameTime() const
+{
+  return m_clockSync.now(enet_time_get()) + CLOCK_LEAD;
+}
+
+static_assert(INPUT_REDUNDANCY <= INPUT_HISTORY_SIZE && INPUT_REDUNDANCY <= UINT8_MAX);
+
+void NetClient::sendInput(uint32_t tick, float thr, float steer)
+{
+  if (!m_inputsHistory.empty()) {
+    // если кадр был длиннее тика, пропущенные тики получают предыдущий ввод, как и на сервере
+    const EntityInput lastInput = m_inputsHistory.back();
+    const uint32_t firstSkippedTick = std::max(m_inputsHistory.backTick() + 1, tick - std::min(tick, INPUT_HISTORY_SIZE));
+    for (uint32_t skippedTick = firstSkippedTick; skippedTick < tick; ++skippedTick) {
+      m_inputsHistory.insert(skippedTick, lastInput);
+    }
+  }
+  m_inputsHistory.insert(tick, {thr, steer});
+
+  NetworkCommand command;
+  command.type = E_COMMAND_INPUT;
+  command.eid = m_myEntity;
+  command.tick = tick;
+  const uint32_t firstTick = std::max(m_inputsHistory.frontTick(), tick + 1 - std::min(tick + 1, INPUT_REDUNDANCY));
+  for (uint32_t inputTick = firstTick; inputTick <= tick; ++inputTick) {
+    command.inputs[command.count++] = m_inputsHistory[inputTick];
+  }
+  send(command);
+}
+
+// Возвращает false, если будущего снепшота для simulateTime еще нет (недостача в буфере)
+bool NetClient::setCorrectSnapshotInterval(size_t entityIndexInVector, uint32_t simulateTime)
+{
+  Snapshot &eInPast = m_entitiesInPast[entityIndexInVector];
+  auto &snapshots = m_snapshotsHistory[entityIndexInVector];
+  while (snapshots.frontTick() != snapshots.backTick() && snapshots.frontTick() * fixedDt <= simulateTime) {
+    eInPast = snapshots.front();
+    snapshots.popFront();
+  }
+  const Snapshot &eInFuture = snapshots.front();
+  m_interpolationSamples.set(entityIndexInVector, eInPast.entity, eInPast.velocity, eInFuture.entity, eInFuture.velocity);
+  return eInFuture.entity.tick * fixedDt >= simulateTime;
+}
+
+void NetClient::interpolateEntities(size_t begin, size_t end, uint32_t simulateTime)
+{
+  hermite_interpolate(m_interpolationSamples, begin, end, simulateTime,
+                      m_interpolatedX.data(), m_interpolatedY.data(), m_interpolatedOri.data());
+  for (size_t i = begin; i < end; ++i)
+  {
+    m_entities[i].x = m_interpolatedX[i];
+    m_entities[i].y = m_interpolatedY[i];
+    m_entities[i].ori = m_interpolatedOri[i];
+  }
+}
+
+void NetClient::setCorrectLocalHistoryInterval(size_t entityIndexInVector, uint32_t simulateTime)
+{
+  // скорость своей сущности берется из предсказанного состояния, без квантования
+  const uint32_t simulateTimeTick = (simulateTime / fixedDt) + 1;
+  const Entity &eInPast = m_localHistory[simulateTimeTick - 1];
+  const Entity &eInFuture = m_localHistory[simulateTimeTick];
+  m_interpolationSamples.set(entityIndexInVector, eInPast, entity_velocity(eInPast), eInFuture, entity_velocity(eInFuture));
+}
+
+void NetClient::simulateLocal(uint32_t simulateTime, float thr, float steer)
+{
+  const uint32_t simulateTimeTick = (simulateTime / fixedDt) + 1;
+  while (m_currentTick * fixedDt <= simulateTime) {
+    ++m_currentTick;
+
+    Entity e = m_localHistory.back();
+    if (m_currentTick >= simulateTimeTick) {
+      e.thr = thr; e.steer = steer;
+    }
+    simulate_entity(e, fixedDt * 0.001f);
+
+    e.tick = m_currentTick;
+    m_localHistory.insert(m_currentTick, e);
+  }
+}
+
+// Сверка предсказания с сервером. Снепшоты своей сущности за кадр сливаются в один: последующие состояния
+// зависят только от самого нового серверного состояния и записанных вводов, поэтому нужен один перенакат от него.
+// Перенакат останавливается, как только пересчитанное состояние совпало с ранее предсказанным:
+// дальше история получится такой же, потому что симуляция детерминирована
+void NetClient::adjustHistory()
+{
+  if (!m_hasMyEntitySnapshot) {
+    return;
+  }
+  const Entity& entityServerState = m_lastMyEntitySnapshot;
+  if (!m_localHistory.contains(entityServerState.tick)) {
+    // сервер мог считать тики быстрее чем клиент, поэтому требуемой записи в истории еще могло не быть,
+    // тогда снепшот сверится в следующем кадре
+    return;
+  }
+  m_hasMyEntitySnapshot = false;
+  if (m_lastSync >= entityServerState.tick) {
+    // вдруг енет в неправильном порядке (по тикам) пошлет снепшоты и тогда все упадет, 
+    // может конечно он следит за порядком, но не хочу разбираться поэтому поставил костыль
+    return;
+  }
+  Entity &entityCurrentState = m_localHistory[entityServerState.tick];
+  if (entity_state_hash(entityServerState) != entity_state_hash(entityCurrentState)) 
+  {
+    assert(entityServerState.tick == entityCurrentState.tick);
+
+    // замена неправильно посчитанного локального состояния на серверное
+    entityCurrentState = entityServerState;
+
+    // перенакат последующей истории состояний с вводами, которые были применены при предсказании
+    const uint32_t depth = m_localHistory.backTick() - entityServerState.tick;
+    uint32_t replayed = 0;
+    for (uint32_t tick = entityServerState.tick + 1; tick <= m_localHistory.backTick(); ++tick)
+    {
+      Entity &entityPredictedState = m_localHistory[tick];
+      Entity entityNewState = m_localHistory[tick - 1];
+      entityNewState.thr = entityPredictedState.thr;
+      entityNewState.steer = entityPredictedState.steer;
+      simulate_entity(entityNewState, fixedDt * 0.001f);
+      entityNewState.tick = tick;
+      ++replayed;
+      if (entity_state_hash(entityNewState) == entity_state_hash(entityPredictedState)) {
+        ++m_reconciliationStats.earlyOuts;
+        break;
+      }
+      entityPredictedState = entityNewState;
+    }
+
+    ++m_reconciliationStats.rollbacks;
+    m_reconciliationStats.rollbackDepth += depth;
+    m_reconciliationStats.maxRollbackDepth = std::max(m_reconciliationStats.maxRollbackDepth, depth);
+    m_reconciliationStats.replayedTicks += replayed;
+    if (m_logRollbacks) {
+      std::cout << entityServerState.tick << " adjust: depth " << depth << ", replayed " << replayed << std::endl;
+    }
+  }
+  m_lastSync = entityServerState.tick;
+  m_localHistory.eraseBefore(m_lastSync);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <enet/enet.h>
+
+#include "entity.h"
+#include "protocol.h"
+#include "params.h"
+#include "ringBuffer.h"
+#include "slotMap.h"
+#include "spscQueue.h"
+#include "clockSync.h"
+#include "jitterBuffer.h"
+#include "interpolation.h"
+
+struct ReconciliationStats
+{
+  uint32_t snapshots = 0;        // снепшотов своей сущности
+  uint32_t coalesced = 0;        // снепшотов, поглощенных более новым в том же кадре
+  uint32_t rollbacks = 0;
+  uint32_t earlyOuts = 0;        // перенакатов, сошедшихся с предсказанием раньше настоящего
+  uint64_t rollbackDepth = 0;    // сумма глубин откатов в тиках
+  uint32_t maxRollbackDepth = 0;
+  uint64_t replayedTicks = 0;
+};
+
+// Сетевая часть клиента без отрисовки и без источника ввода: соединение с сервером, синхронизация часов,
+// предсказание своей сущности со сверкой по снепшотам и интерполяция остальных.
+// Все состояние внутри объекта, поэтому в одном процессе можно держать сколько угодно клиентов (см. w5_bot).
+// С networkThread хостом ENet владеет отдельный поток: он обслуживает сокет без задержки на кадр, ставит время прихода
+// каждому пакету и передает пакеты и исходящие команды через очереди без блокировок, поток кадра никогда не ждет сеть.
+// Без него ENet обслуживается в service() в потоке вызывающего.
+class NetClient
+{
+ public:
+    NetClient() = default;
+    ~NetClient();
+    NetClient(const NetClient&) = delete;
+    NetClient& operator=(const NetClient&) = delete;
+
+    bool connect(const char *host, uint16_t port, bool networkThread = false);
+
+    // Обработка всех пришедших событий, timeout - сколько ждать, если событий нет
+    void service(uint32_t timeout);
+
+    // Пока не набраны первые замеры часов и не пришла своя сущность, шлет частые ping и возвращает false.
+    // Когда все готово, ставит часы и начинает локальную симуляцию
+    bool start();
+    bool isStarted() const { return m_started; }
+
+    // Один кадр: подводка часов, отправка ввода, предсказание, сверка и интерполяция всех сущностей
+    void update(float thr, float steer);
+
+    const std::vector<Entity>& entities() const { return m_entities; }
+    uint16_t controlledEntity() const { return m_myEntity; }
+    const ReconciliationStats& reconciliationStats() const { return m_reconciliationStats; }
+    const ClockSync& clockSync() const { return m_clockSync; }
+    const JitterBuffer& jitterBuffer() const { return m_jitterBuffer; }
+
+    // Писать в stdout каждый откат предсказания
+    void setLogRollbacks(bool log) { m_logRollbacks = log; }
+
+    // Команд, не влезших в очередь к сетевому потоку (ввод все равно повторится в следующих пакетах)
+    uint32_t droppedCommands() const { return m_droppedCommands; }
+
+ private:
+    struct NetworkEvent
+    {
+        ENetEventType type = ENET_EVENT_TYPE_NONE;
+        ENetPacket *packet = nullptr;
+        uint32_t arrivalTime = 0;
+    };
+
+    enum NetworkCommandType : uint8_t
+    {
+        E_COMMAND_JOIN = 0,
+        E_COMMAND_TIME_PING,
+        E_COMMAND_INPUT
+    };
+
+    // Все, что уходит на сервер, выполняется там, где живет хост ENet. Время в ping ставится в момент отправки
+    struct NetworkCommand
+    {
+        NetworkCommandType type = E_COMMAND_JOIN;
+        uint16_t eid = invalid_entity;
+        uint32_t tick = 0;
+        uint8_t count = 0;
+        EntityInput inputs[INPUT_REDUNDANCY];
+    };
+
+    void networkLoop();
+    void handleEvent(const NetworkEvent &event);
+    void send(const NetworkCommand &command);
+    void execute(const NetworkCommand &command);
+
+    void onNewEntity(ENetPacket *packet);
+    void onSetControlledEntity(ENetPacket *packet);
+    void onRemoveEntity(ENetPacket *packet);
+    void onSnapshot(ENetPacket *packet, uint32_t arrivalTime);
+    void onTimePong(ENetPacket *packet, uint32_t arrivalTime);
+    void pingServerTime(uint32_t interval);
+    uint32_t getGameTime() const;
+    void sendInput(uint32_t tick, float thr, float steer);
+    bool setCorrectSnapshotInterval(size_t entityIndexInVector, uint32_t simulateTime);
+    void interpolateEntities(size_t begin, size_t end, uint32_t simulateTime);
+    void setCorrectLocalHistoryInterval(size_t entityIndexInVector, uint32_t simulateTime);
+    void simulateLocal(uint32_t simulateTime, float thr, float steer);
+    void adjustHistory();
+
+    ENetHost *m_host = nullptr;
+    ENetPeer *m_serverPeer = nullptr;
+    std::thread m_networkThread;
+    std::atomic<bool> m_networkRunning{false};
+    SpscQueue<NetworkEvent, 1024> m_incoming;
+    SpscQueue<NetworkCommand, 256> m_outgoing;
+    uint32_t m_droppedCommands = 0;
+    bool m_connected = false;
+    bool m_started = false;
+    bool m_logRollbacks = false;
+
+    std::vector<Entity> m_entities;
+    struct Snapshot
+    {
+        Entity entity;
+        EntityVelocity velocity;
+    };
+    std::vector<Snapshot> m_entitiesInPast;
+    std::vector<TickRingBuffer<Snapshot, SNAPSHOT_HISTORY_SIZE>> m_snapshotsHistory;
+    HermiteSamples m_interpolationSamples;
+    std::vector<float> m_interpolatedX;
+    std::vector<float> m_interpolatedY;
+    std::vector<float> m_interpolatedOri;
+    TickRingBuffer<Entity, LOCAL_HISTORY_SIZE> m_localHistory;
+    TickRingBuffer<EntityInput, INPUT_HISTORY_SIZE> m_inputsHistory;
+    SlotMap<ENTITY_SLOTS> m_entityIds; // eid -> индекс во всех массивах сущностей выше
+    uint16_t m_myEntity = invalid_entity;
+    uint32_t m_currentTick = 0;
+    uint32_t m_lastSync = 0;
+    Entity m_lastMyEntitySnapshot;
+    bool m_hasMyEntitySnapshot = false;
+
+    ReconciliationStats m_reconciliationStats;
+    ClockSync m_clockSync;
+    JitterBuffer m_jitterBuffer;
+    uint32_t m_lastPingTime = 0;
+};
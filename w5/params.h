@@ -1,5 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
 constexpr uint32_t fixedDt = 20;
 constexpr uint32_t FIXED_OFFSET = fixedDt * 3; // можно увеличить чтобы при большом rtt не было подергиваний из-за перенакатов
-constexpr uint32_t SEND_TIMEOUT = 100;
+constexpr uint32_t SEND_TIMEOUT = 100; // период снепшотов обычной сущности при нормальном канале; ближние и быстрые чаще, при перегрузке реже
 constexpr uint32_t FPS = 60;
-constexpr uint32_t TIME_PER_FRAME = (1.0 / static_cast<double>(FPS)) * 1000;
\ No newline at end of file
+constexpr uint32_t TIME_PER_FRAME = (1.0 / static_cast<double>(FPS)) * 1000;
+constexpr uint32_t INPUT_HISTORY_SIZE = 64;     // в тиках, степень двойки
+constexpr uint32_t SNAPSHOT_HISTORY_SIZE = 64;  // в тиках, степень двойки
+constexpr uint32_t LOCAL_HISTORY_SIZE = 256;    // в тиках, степень двойки; ~5 секунд предсказания без ответа сервера
+constexpr uint32_t INPUT_REDUNDANCY = 16;       // сколько последних тиков ввода повторяется в каждом пакете
+constexpr uint32_t CLOCK_LEAD = FIXED_OFFSET + TIME_PER_FRAME; // клиент живет впереди сервера, чтобы ввод (снимается раз в кадр) успевал к своему тику
+constexpr uint32_t CLOCK_SYNC_INTERVAL = 500;   // мс между замерами времени
+constexpr uint32_t INITIAL_CLOCK_SYNC_INTERVAL = 10;
+constexpr uint32_t INITIAL_CLOCK_SAMPLES = 8;
+constexpr uint32_t LAG_COMPENSATION_HISTORY_SIZE = 64;  // в тиках, степень двойки; 1.28 секунды назад
+constexpr uint32_t ENTITY_SLOTS = 4096;                  // степень двойки; остальные биты eid - поколение
+constexpr size_t MAX_PEERS = 512;                        // по умолчанию, w5_server --max-peers; ENet позволяет до 4095
+constexpr size_t LAG_COMPENSATION_MAX_ENTITIES = ENTITY_SLOTS; // 64 * 4096 * 12 байт = 3 Мб на всю историю
+constexpr uint32_t TICK_STATS_INTERVAL = 10000; // в мс, как часто сервер печатает точность тиков
+constexpr uint32_t WORLD_HASH_INTERVAL = 50;    // в тиках, как часто записывать хеш мира для проверки воспроизведения
@@ -1,75 +1,150 @@
 #include "protocol.h"
 #include <cstring> // memcpy
+#include <math.h>
+#include "netStats.h"
+#include "netSend.h"
 
 void send_join(ENetPeer *peer)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_JOIN);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t), ENET_PACKET_FLAG_RELIABLE);
   *packet->data = E_CLIENT_TO_SERVER_JOIN;
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_new_entity(ENetPeer *peer, const Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_NEW_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(Entity),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_NEW_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &ent, sizeof(Entity)); ptr += sizeof(Entity);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
-void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float steer, uint32_t tick)
+void send_remove_entity(ENetPeer *peer, uint16_t eid)
 {
-  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t) +
-                                                   2 * sizeof(float) + sizeof(tick),
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_REMOVE_ENTITY);
+  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t),
+                                                   ENET_PACKET_FLAG_RELIABLE);
+  uint8_t *ptr = packet->data;
+  *ptr = E_SERVER_TO_CLIENT_REMOVE_ENTITY; ptr += sizeof(uint8_t);
+  memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
+
+  net_send_packet(peer, 0, packet);
+}
+
+static constexpr size_t INPUT_RUN_SIZE = sizeof(uint8_t) + 2 * sizeof(float);
+static constexpr size_t INPUT_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint8_t);
+
+// Пакет несет вводы за несколько последних тиков, чтобы потеря одного пакета не приводила к перенакату.
+// Клавиатурный ввод меняется редко, поэтому вводы сжимаются в серии одинаковых значений (от новых к старым):
+// | type | eid | lastTick | nRuns | (length, thr, steer) * nRuns |
+void send_entity_input(ENetPeer *peer, uint16_t eid, uint32_t lastTick, const EntityInput *inputs, size_t count)
+{
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_INPUT);
+  uint8_t runLengths[UINT8_MAX];
+  size_t runStarts[UINT8_MAX];
+  uint8_t nRuns = 0;
+  for (size_t i = count; i > 0 && nRuns < UINT8_MAX; --i)
+  {
+    const EntityInput &input = inputs[i - 1];
+    const bool sameAsRun = nRuns > 0 && runLengths[nRuns - 1] < UINT8_MAX &&
+                           inputs[runStarts[nRuns - 1]].thr == input.thr &&
+                           inputs[runStarts[nRuns - 1]].steer == input.steer;
+    if (sameAsRun) {
+      ++runLengths[nRuns - 1];
+    } else {
+      runStarts[nRuns] = i - 1;
+      runLengths[nRuns] = 1;
+      ++nRuns;
+    }
+  }
+
+  ENetPacket *packet = enet_packet_create(nullptr, INPUT_HEADER_SIZE + nRuns * INPUT_RUN_SIZE,
                                                    ENET_PACKET_FLAG_UNSEQUENCED);
   uint8_t *ptr = packet->data;
   *ptr = E_CLIENT_TO_SERVER_INPUT; ptr += sizeof(uint8_t);
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
-  memcpy(ptr, &thr, sizeof(float)); ptr += sizeof(float);
-  memcpy(ptr, &steer, sizeof(float)); ptr += sizeof(float);
-  memcpy(ptr, &tick, sizeof(tick)); ptr += sizeof(tick);
+  memcpy(ptr, &lastTick, sizeof(uint32_t)); ptr += sizeof(uint32_t);
+  memcpy(ptr, &nRuns, sizeof(uint8_t)); ptr += sizeof(uint8_t);
+  for (uint8_t run = 0; run < nRuns; ++run)
+  {
+    const EntityInput &input = inputs[runStarts[run]];
+    memcpy(ptr, &runLengths[run], sizeof(uint8_t)); ptr += sizeof(uint8_t);
+    memcpy(ptr, &input.thr, sizeof(float)); ptr += sizeof(float);
+    memcpy(ptr, &input.steer, sizeof(float)); ptr += sizeof(float);
+  }
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
+}
+
+static int16_t quantize_velocity(float v, float scale)
+{
+  const float q = v * scale;
+  return static_cast<int16_t>(q < INT16_MIN ? INT16_MIN : q > INT16_MAX ? INT16_MAX : lrintf(q));
 }
 
 void send_snapshot(ENetPeer *peer, const Entity &e)
 {
-  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(Entity),
-                                                   ENET_PACKET_FLAG_UNSEQUENCED);
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SNAPSHOT);
+  ENetPacket *packet = enet_packet_create(nullptr, SNAPSHOT_SIZE, ENET_PACKET_FLAG_UNSEQUENCED);
+  const EntityVelocity velocity = entity_velocity(e);
+  const int16_t quantized[3] = {quantize_velocity(velocity.vx, VELOCITY_SCALE),
+                                quantize_velocity(velocity.vy, VELOCITY_SCALE),
+                                quantize_velocity(velocity.angVel, ANGULAR_VELOCITY_SCALE)};
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_SNAPSHOT; ptr += sizeof(uint8_t);
   memcpy(ptr, &e, sizeof(Entity)); ptr += sizeof(Entity);
+  memcpy(ptr, quantized, sizeof(quantized)); ptr += sizeof(quantized);
   // memcpy(ptr, &x, sizeof(float)); ptr += sizeof(float);
   // memcpy(ptr, &y, sizeof(float)); ptr += sizeof(float);
   // memcpy(ptr, &ori, sizeof(float)); ptr += sizeof(float);
   // memcpy(ptr, &tick, sizeof(tick)); ptr += sizeof(tick);
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
-void send_set_time(ENetPeer *peer, uint32_t time)
+// ping/pong синхронизации часов идут без надежной доставки: переотправка исказила бы замер rtt,
+// а потерянный замер просто заменится следующим
+void send_time_ping(ENetPeer *peer, uint32_t clientTime)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_TIME_PING);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint32_t),
-                                                   ENET_PACKET_FLAG_RELIABLE);
+                                                   ENET_PACKET_FLAG_UNSEQUENCED);
+  uint8_t *ptr = packet->data;
+  *ptr = E_CLIENT_TO_SERVER_TIME_PING; ptr += sizeof(uint8_t);
+  memcpy(ptr, &clientTime, sizeof(uint32_t)); ptr += sizeof(uint32_t);
+
+  net_send_packet(peer, 1, packet);
+}
+
+void send_time_pong(ENetPeer *peer, uint32_t clientTime, uint32_t serverTime)
+{
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_TIME_PONG);
+  ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + 2 * sizeof(uint32_t),
+                                                   ENET_PACKET_FLAG_UNSEQUENCED);
   uint8_t *ptr = packet->data;
-  *ptr = E_SERVER_TO_CLIEN_SET_TIME; ptr += sizeof(uint8_t);
-  memcpy(ptr, &time, sizeof(uint32_t)); ptr += sizeof(uint32_t);
+  *ptr = E_SERVER_TO_CLIENT_TIME_PONG; ptr += sizeof(uint8_t);
+  memcpy(ptr, &clientTime, sizeof(uint32_t)); ptr += sizeof(uint32_t);
+  memcpy(ptr, &serverTime, sizeof(uint32_t)); ptr += sizeof(uint32_t);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 1, packet);
 }
 
 MessageType get_packet_type(ENetPacket *packet)
@@ -77,35 +152,115 @@ MessageType get_packet_type(ENetPacket *packet)
   return (MessageType)*packet->data;
 }
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent)
+const char *message_type_name(uint8_t type)
 {
+  switch (type)
+  {
+  case E_CLIENT_TO_SERVER_JOIN: return "join";
+  case E_SERVER_TO_CLIENT_NEW_ENTITY: return "new_entity";
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY: return "set_controlled_entity";
+  case E_CLIENT_TO_SERVER_INPUT: return "input";
+  case E_SERVER_TO_CLIENT_SNAPSHOT: return "snapshot";
+  case E_CLIENT_TO_SERVER_TIME_PING: return "time_ping";
+  case E_SERVER_TO_CLIENT_TIME_PONG: return "time_pong";
+  case E_SERVER_TO_CLIENT_REMOVE_ENTITY: return "remove_entity";
+  }
+  return nullptr;
+}
+
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent)
+{
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_NEW_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(Entity))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   ent = *(Entity*)(ptr); ptr += sizeof(Entity);
+  return true;
+}
+
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
+{
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint16_t))
+    return false;
+  uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
+  eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
+  return true;
 }
 
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
+bool deserialize_remove_entity(ENetPacket *packet, uint16_t &eid)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_REMOVE_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint16_t))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
+  return true;
 }
 
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer, uint32_t &tick)
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, std::vector<EntityInputRun> &runs)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_INPUT);
+  runs.clear();
+  if (packet->dataLength < INPUT_HEADER_SIZE) {
+    return false;
+  }
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
-  thr = *(float*)(ptr); ptr += sizeof(float);
-  steer = *(float*)(ptr); ptr += sizeof(float);
-  tick = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  uint32_t tick = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  uint8_t nRuns = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
+  if (packet->dataLength < INPUT_HEADER_SIZE + nRuns * INPUT_RUN_SIZE) {
+    return false;
+  }
+  for (uint8_t run = 0; run < nRuns; ++run)
+  {
+    EntityInputRun inputRun;
+    inputRun.length = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
+    inputRun.thr = *(float*)(ptr); ptr += sizeof(float);
+    inputRun.steer = *(float*)(ptr); ptr += sizeof(float);
+    if (inputRun.length == 0 || inputRun.length > tick + 1) {
+      runs.clear();
+      return false;
+    }
+    inputRun.tick = tick + 1 - inputRun.length;
+    runs.push_back(inputRun);
+    tick = inputRun.tick - 1;
+  }
+  return true;
 }
 
-void deserialize_snapshot(ENetPacket *packet, Entity &e)
+bool deserialize_snapshot(ENetPacket *packet, Entity &e, EntityVelocity &velocity)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SNAPSHOT);
+  if (packet->dataLength < SNAPSHOT_SIZE)
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   e = *(Entity*)(ptr); ptr += sizeof(Entity);
+  int16_t quantized[3];
+  memcpy(quantized, ptr, sizeof(quantized)); ptr += sizeof(quantized);
+  velocity.vx = quantized[0] / VELOCITY_SCALE;
+  velocity.vy = quantized[1] / VELOCITY_SCALE;
+  velocity.angVel = quantized[2] / ANGULAR_VELOCITY_SCALE;
+  return true;
 }
 
-void deserialize_set_time(ENetPacket *packet, uint32_t &time)
+bool deserialize_time_ping(ENetPacket *packet, uint32_t &clientTime)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_TIME_PING);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint32_t))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
-  time = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
-}
\ No newline at end of file
+  clientTime = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  return true;
+}
+
+bool deserialize_time_pong(ENetPacket *packet, uint32_t &clientTime, uint32_t &serverTime)
+{
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_TIME_PONG);
+  if (packet->dataLength < sizeof(uint8_t) + 2 * sizeof(uint32_t))
+    return false;
+  uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
+  clientTime = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  serverTime = *(uint32_t*)(ptr); ptr += sizeof(uint32_t);
+  return true;
+}
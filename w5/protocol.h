@@ -1,6 +1,8 @@
 #pragma once
 #include <enet/enet.h>
 #include <cstdint>
+#include <cstddef>
+#include <vector>
 #include "entity.h"
 
 enum MessageType : uint8_t
@@ -10,20 +12,54 @@ enum MessageType : uint8_t
   E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY,
   E_CLIENT_TO_SERVER_INPUT,
   E_SERVER_TO_CLIENT_SNAPSHOT,
-  E_SERVER_TO_CLIEN_SET_TIME
+  E_CLIENT_TO_SERVER_TIME_PING,
+  E_SERVER_TO_CLIENT_TIME_PONG,
+  E_SERVER_TO_CLIENT_REMOVE_ENTITY
 };
 
+// Ввод игрока на один тик
+struct EntityInput
+{
+  float thr = 0.f;
+  float steer = 0.f;
+};
+
+// Ввод, не менявшийся на тиках [tick, tick + length)
+struct EntityInputRun
+{
+  uint32_t tick = 0;
+  uint8_t length = 0;
+  float thr = 0.f;
+  float steer = 0.f;
+};
+
+constexpr float VELOCITY_SCALE = 256.f;         // до 128 ед/с
+constexpr float ANGULAR_VELOCITY_SCALE = 1024.f; // до 32 рад/с
+
 void send_join(ENetPeer *peer);
 void send_new_entity(ENetPeer *peer, const Entity &ent);
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid);
-void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float steer, uint32_t tick);
+void send_remove_entity(ENetPeer *peer, uint16_t eid);
+// inputs - вводы на подряд идущие тики, последний из них на тик lastTick
+void send_entity_input(ENetPeer *peer, uint16_t eid, uint32_t lastTick, const EntityInput *inputs, size_t count);
+constexpr size_t SNAPSHOT_SIZE = sizeof(uint8_t) + sizeof(Entity) + 3 * sizeof(int16_t);
+constexpr size_t SNAPSHOT_WIRE_SIZE = SNAPSHOT_SIZE + 4 + 8 + 28; // + заголовки ENet (протокол и команда) и UDP/IP
+
+// Снепшот: состояние сущности и ее квантованная скорость (int16, 1/VELOCITY_SCALE ед/с и 1/ANGULAR_VELOCITY_SCALE рад/с)
 void send_snapshot(ENetPeer *peer, const Entity &e);
-void send_set_time(ENetPeer *peer, uint32_t time);
+void send_time_ping(ENetPeer *peer, uint32_t clientTime);
+void send_time_pong(ENetPeer *peer, uint32_t clientTime, uint32_t serverTime);
 
 MessageType get_packet_type(ENetPacket *packet);
+// Имя типа для счетчиков трафика, записи корпуса и fuzz-драйвера (common/), nullptr для неизвестного типа
+const char *message_type_name(uint8_t type);
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent);
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer, uint32_t &tick);
-void deserialize_snapshot(ENetPacket *packet, Entity &e);
-void deserialize_set_time(ENetPacket *packet, uint32_t &time);
+// false - пакет короче сообщения своего типа или с неверными данными, его пропускают
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent);
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
+bool deserialize_remove_entity(ENetPacket *packet, uint16_t &eid);
+// runs идут от самого нового к самому старому
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, std::vector<EntityInputRun> &runs);
+bool deserialize_snapshot(ENetPacket *packet, Entity &e, EntityVelocity &velocity);
+bool deserialize_time_ping(ENetPacket *packet, uint32_t &clientTime);
+bool deserialize_time_pong(ENetPacket *packet, uint32_t &clientTime, uint32_t &serverTime);
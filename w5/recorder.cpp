@@ -0,0 +1,145 @@
+#include "recorder.h"
+#include <cstdio>
+#include <cstring> // memcpy
+
+#include "params.h"
+
+static_assert(INPUT_HISTORY_SIZE <= UINT8_MAX, "input tick offset is stored in one byte");
+
+static constexpr char RECORDING_MAGIC[4] = {'W', '5', 'R', 'L'};
+static constexpr uint32_t RECORDING_VERSION = 2;
+
+static FILE *recordingFile = nullptr;
+
+template<typename T>
+static void write_value(const T &value)
+{
+  fwrite(&value, sizeof(T), 1, recordingFile);
+}
+
+template<typename T>
+static bool read_value(FILE *file, T &value)
+{
+  return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+bool recorder_open(const char *path)
+{
+  recordingFile = fopen(path, "wb");
+  if (!recordingFile) {
+    return false;
+  }
+  fwrite(RECORDING_MAGIC, sizeof(RECORDING_MAGIC), 1, recordingFile);
+  write_value(RECORDING_VERSION);
+  write_value(fixedDt);
+  return true;
+}
+
+void recorder_close()
+{
+  if (recordingFile) {
+    fclose(recordingFile);
+    recordingFile = nullptr;
+  }
+}
+
+void record_join(uint32_t worldTick, const Entity &e)
+{
+  if (!recordingFile) {
+    return;
+  }
+  write_value(E_RECORD_JOIN);
+  write_value(worldTick);
+  write_value(e);
+}
+
+void record_input(uint32_t worldTick, uint16_t eid, uint32_t tick, float thr, float steer)
+{
+  if (!recordingFile) {
+    return;
+  }
+  const uint8_t tickOffset = static_cast<uint8_t>(tick - worldTick);
+  write_value(E_RECORD_INPUT);
+  write_value(worldTick);
+  write_value(eid);
+  write_value(tickOffset);
+  write_value(thr);
+  write_value(steer);
+}
+
+void record_hash(uint32_t tick, uint32_t hash)
+{
+  if (!recordingFile) {
+    return;
+  }
+  write_value(E_RECORD_HASH);
+  write_value(tick);
+  write_value(hash);
+  // сервер обычно просто убивают, поэтому лог сбрасывается на диск регулярно
+  fflush(recordingFile);
+}
+
+void record_leave(uint32_t worldTick, uint16_t eid)
+{
+  if (!recordingFile) {
+    return;
+  }
+  write_value(E_RECORD_LEAVE);
+  write_value(worldTick);
+  write_value(eid);
+}
+
+bool read_recording(const char *path, std::vector<RecordedEvent> &events)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[sizeof(RECORDING_MAGIC)];
+  uint32_t version = 0;
+  uint32_t recordedDt = 0;
+  const bool headerOk = fread(magic, sizeof(magic), 1, file) == 1 &&
+                        memcmp(magic, RECORDING_MAGIC, sizeof(magic)) == 0 &&
+                        read_value(file, version) && version == RECORDING_VERSION &&
+                        read_value(file, recordedDt) && recordedDt == fixedDt;
+  if (!headerOk) {
+    fclose(file);
+    return false;
+  }
+
+  events.clear();
+  RecordType type;
+  while (read_value(file, type))
+  {
+    RecordedEvent event;
+    event.type = type;
+    bool ok = false;
+    switch (type)
+    {
+    case E_RECORD_JOIN:
+      ok = read_value(file, event.worldTick) && read_value(file, event.entity);
+      break;
+    case E_RECORD_INPUT:
+    {
+      uint8_t tickOffset = 0;
+      ok = read_value(file, event.worldTick) && read_value(file, event.eid) && read_value(file, tickOffset) &&
+           read_value(file, event.thr) && read_value(file, event.steer);
+      event.tick = event.worldTick + tickOffset;
+      break;
+    }
+    case E_RECORD_HASH:
+      ok = read_value(file, event.tick) && read_value(file, event.hash);
+      event.worldTick = event.tick;
+      break;
+    case E_RECORD_LEAVE:
+      ok = read_value(file, event.worldTick) && read_value(file, event.eid);
+      break;
+    }
+    if (!ok) {
+      break; // лог мог оборваться посреди записи, если сервер убили
+    }
+    events.push_back(event);
+  }
+  fclose(file);
+  return true;
+}
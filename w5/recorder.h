@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "entity.h"
+
+// Запись всего, что влияет на симуляцию мира: появления сущностей и принятые вводы, с тиком мира, на котором они случились.
+// Симуляция детерминирована, поэтому по такому логу w5_replay воспроизводит мир бит в бит без клиентов.
+// Раз в WORLD_HASH_INTERVAL тиков пишется хеш мира, чтобы при воспроизведении проверить совпадение.
+// Формат: | 'W5RL' | version u32 | fixedDt u32 | записи... |
+//   JOIN:  | type u8 | worldTick u32 | Entity |
+//   INPUT: | type u8 | worldTick u32 | eid u16 | tick - worldTick u8 | thr f32 | steer f32 |
+//   HASH:  | type u8 | tick u32 | hash u32 |
+//   LEAVE: | type u8 | worldTick u32 | eid u16 |
+
+enum RecordType : uint8_t
+{
+  E_RECORD_JOIN = 0,
+  E_RECORD_INPUT,
+  E_RECORD_HASH,
+  E_RECORD_LEAVE
+};
+
+struct RecordedEvent
+{
+  RecordType type = E_RECORD_JOIN;
+  uint32_t worldTick = 0;
+  Entity entity;
+  uint16_t eid = invalid_entity;
+  uint32_t tick = 0;
+  float thr = 0.f;
+  float steer = 0.f;
+  uint32_t hash = 0;
+};
+
+bool recorder_open(const char *path);
+void recorder_close();
+
+void record_join(uint32_t worldTick, const Entity &e);
+void record_input(uint32_t worldTick, uint16_t eid, uint32_t tick, float thr, float steer);
+void record_hash(uint32_t tick, uint32_t hash);
+void record_leave(uint32_t worldTick, uint16_t eid);
+
+bool read_recording(const char *path, std::vector<RecordedEvent> &events);
@@ -0,0 +1,119 @@
+// Воспроизведение записанного сервером лога без сети и клиентов, с максимальной скоростью.
+// Использование: w5_replay <log> [--verify] [--repeat N]
+//   --verify   сверять хеши мира с записанными сервером
+//   --repeat N прогнать лог N раз (для замеров производительности)
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "world.h"
+#include "recorder.h"
+
+struct ReplayResult
+{
+  uint64_t ticks = 0;
+  uint64_t entityTicks = 0;
+  uint32_t hashesChecked = 0;
+  uint32_t hashMismatches = 0;
+  uint32_t firstMismatchTick = 0;
+};
+
+static void step_to(uint32_t tick, ReplayResult &result)
+{
+  while (world_tick() < tick)
+  {
+    world_step();
+    ++result.ticks;
+    result.entityTicks += world_entities_count();
+  }
+}
+
+static ReplayResult replay(const std::vector<RecordedEvent> &events, bool verify)
+{
+  ReplayResult result;
+  world_reset();
+  for (const RecordedEvent &event : events)
+  {
+    step_to(event.worldTick, result);
+    switch (event.type)
+    {
+    case E_RECORD_JOIN:
+      world_add_entity(event.entity);
+      break;
+    case E_RECORD_INPUT:
+      world_add_input(event.eid, event.tick, event.thr, event.steer);
+      break;
+    case E_RECORD_LEAVE:
+      world_remove_entity(event.eid);
+      break;
+    case E_RECORD_HASH:
+      if (verify) {
+        ++result.hashesChecked;
+        if (world_state_hash() != event.hash) {
+          if (result.hashMismatches == 0) {
+            result.firstMismatchTick = event.tick;
+          }
+          ++result.hashMismatches;
+        }
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s <log> [--verify] [--repeat N]\n", argv[0]);
+    return 1;
+  }
+  bool verify = false;
+  int repeat = 1;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--verify") == 0)
+      verify = true;
+    else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::max(atoi(argv[++i]), 1);
+  }
+
+  std::vector<RecordedEvent> events;
+  if (!read_recording(argv[1], events))
+  {
+    printf("Cannot read recording %s\n", argv[1]);
+    return 1;
+  }
+  printf("%zu events\n", events.size());
+
+  ReplayResult total;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; ++i)
+  {
+    const ReplayResult result = replay(events, verify);
+    total.ticks += result.ticks;
+    total.entityTicks += result.entityTicks;
+    total.hashesChecked += result.hashesChecked;
+    if (result.hashMismatches > 0 && total.hashMismatches == 0)
+      total.firstMismatchTick = result.firstMismatchTick;
+    total.hashMismatches += result.hashMismatches;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%llu ticks, %llu entity ticks in %.3f s\n", (unsigned long long)total.ticks, (unsigned long long)total.entityTicks, seconds);
+  printf("%.0f ticks/s, %.0f entity ticks/s\n", total.ticks / seconds, total.entityTicks / seconds);
+  if (verify)
+  {
+    printf("%u hashes checked, %u mismatches\n", total.hashesChecked, total.hashMismatches);
+    if (total.hashMismatches > 0)
+    {
+      printf("first mismatch at tick %u\n", total.firstMismatchTick);
+      return 2;
+    }
+  }
+  return 0;
+}
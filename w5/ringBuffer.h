@@ -0,0 +1,128 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cassert>
+
+// Кольцевой буфер фиксированного размера, где элемент адресуется номером тика: ячейка = tick & (Capacity - 1).
+// Хранит окно не длиннее Capacity тиков [frontTick, backTick], тики внутри окна могут идти с пропусками
+// (снепшоты приходят раз в несколько тиков). Поиск по тику O(1), в установившемся режиме память не выделяется.
+template<typename T, uint32_t Capacity>
+class TickRingBuffer {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+    TickRingBuffer() {
+        clear();
+    }
+
+    // Кладет значение для тика. Если тик выходит за окно вперед, окно сдвигается и самые старые тики теряются.
+    // Возвращает false, если тик слишком старый чтобы поместиться в окно.
+    bool insert(uint32_t tick, const T& value) {
+        if (m_empty) {
+            m_frontTick = tick;
+            m_backTick = tick;
+            m_empty = false;
+        }
+        else if (tick > m_backTick) {
+            m_backTick = tick;
+            if (m_backTick - m_frontTick >= Capacity) {
+                m_frontTick = m_backTick - Capacity + 1;
+                seekFront();
+            }
+        }
+        else if (tick < m_frontTick) {
+            if (m_backTick - tick >= Capacity) {
+                return false;
+            }
+            m_frontTick = tick;
+        }
+        m_ticks[slot(tick)] = tick;
+        m_values[slot(tick)] = value;
+        return true;
+    }
+
+    bool contains(uint32_t tick) const {
+        return !m_empty && tick >= m_frontTick && tick <= m_backTick && m_ticks[slot(tick)] == tick;
+    }
+
+    T* find(uint32_t tick) {
+        return contains(tick) ? &m_values[slot(tick)] : nullptr;
+    }
+
+    const T* find(uint32_t tick) const {
+        return contains(tick) ? &m_values[slot(tick)] : nullptr;
+    }
+
+    T& operator[](uint32_t tick) {
+        assert(contains(tick));
+        return m_values[slot(tick)];
+    }
+
+    T& front() {
+        assert(!m_empty);
+        return m_values[slot(m_frontTick)];
+    }
+
+    T& back() {
+        assert(!m_empty);
+        return m_values[slot(m_backTick)];
+    }
+
+    uint32_t frontTick() const {
+        return m_frontTick;
+    }
+
+    uint32_t backTick() const {
+        return m_backTick;
+    }
+
+    bool empty() const {
+        return m_empty;
+    }
+
+    // Удаляет самый старый элемент, новым началом окна становится следующий записанный тик
+    void popFront() {
+        assert(!m_empty);
+        m_ticks[slot(m_frontTick)] = INVALID_TICK;
+        if (m_frontTick == m_backTick) {
+            m_empty = true;
+            return;
+        }
+        ++m_frontTick;
+        seekFront();
+    }
+
+    // Удаляет все элементы с тиками меньше tick
+    void eraseBefore(uint32_t tick) {
+        while (!m_empty && m_frontTick < tick) {
+            popFront();
+        }
+    }
+
+    void clear() {
+        m_ticks.fill(INVALID_TICK);
+        m_frontTick = 0;
+        m_backTick = 0;
+        m_empty = true;
+    }
+
+ private:
+    static uint32_t slot(uint32_t tick) {
+        return tick & (Capacity - 1);
+    }
+
+    // Двигает начало окна до первого записанного тика, не дальше чем на Capacity ячеек
+    void seekFront() {
+        while (m_frontTick < m_backTick && m_ticks[slot(m_frontTick)] != m_frontTick) {
+            m_ticks[slot(m_frontTick)] = INVALID_TICK;
+            ++m_frontTick;
+        }
+    }
+
+    static constexpr uint32_t INVALID_TICK = UINT32_MAX;
+    std::array<T, Capacity> m_values{};
+    std::array<uint32_t, Capacity> m_ticks;
+    uint32_t m_frontTick;
+    uint32_t m_backTick;
+    bool m_empty;
+};
@@ -2,95 +2,134 @@
 #include <iostream>
 #include "entity.h"
 #include "protocol.h"
+#include "netStats.h"
+#include "packetCapture.h"
 #include "mathUtils.h"
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <map>
-#include <unordered_map>
-#include <queue>
+#include <algorithm>
 
 #include "params.h"
-static std::vector<Entity> entities;
-static std::vector<Entity> entitiesInputs;
+#include "world.h"
+#include "recorder.h"
+#include "tickWaiter.h"
+#include "snapshotScheduler.h"
+#include <unordered_map>
 static std::map<uint16_t, ENetPeer*> controlledMap;
-static std::unordered_map<uint16_t, size_t> eidToIndexInVectorMap;
-static std::vector<std::queue<Entity>> snapshotsHistory;
+static std::unordered_map<ENetPeer*, SnapshotScheduler> snapshotSchedulers;
 
-void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host, uint32_t time)
+void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
 {
-  uint32_t tick = static_cast<float>(time) / fixedDt;
   // send all entities
-  for (const Entity &ent : entities)
-    send_new_entity(peer, ent);
-
-  // find max eid
-  uint16_t maxEid = entities.empty() ? invalid_entity : entities[0].eid;
-  for (const Entity &e : entities)
-    maxEid = std::max(maxEid, e.eid);
-  uint16_t newEid = maxEid + 1;
+  for (size_t i = 0; i < world_entities_count(); ++i)
+    send_new_entity(peer, world_get_entity(i));
+
   uint32_t color = 0xff000000 +
                    0x00440000 * (rand() % 5 + 1) +
                   //  0x00440000 * (rand() % 5 + 1) +
                    0x00000044 * (rand() % 5 + 1);
   float x = (rand() % 4) * 5.f;
   float y = (rand() % 4) * 5.f;
-  Entity ent = {color, x, y, 0.f, (rand() / RAND_MAX) * 3.141592654f, 0.f, 0.f, tick, newEid};
-  eidToIndexInVectorMap[ent.eid] = entities.size();
-  entities.push_back(ent);
-  entitiesInputs.push_back(ent);
+  Entity ent = {color, x, y, 0.f, (rand() / RAND_MAX) * 3.141592654f, 0.f, 0.f, world_tick(), invalid_entity};
+  const uint16_t newEid = world_add_entity(ent);
+  if (newEid == invalid_entity) {
+    printf("World is full\n");
+    return;
+  }
+  ent.eid = newEid;
   controlledMap[newEid] = peer;
-  std::queue<Entity> newQueue; newQueue.push(ent);
-  snapshotsHistory.push_back(newQueue);
+  snapshotSchedulers[peer].setControlledEntity(newEid);
 
   // send info about new entity to everyone
   for (size_t i = 0; i < host->connectedPeers; ++i)
     send_new_entity(&host->peers[i], ent);
   // send info about controlled entity
   send_set_controlled_entity(peer, newEid);
-  time = enet_time_get();
-  send_set_time(peer, time);
 }
 
-void simulate_entity_fixed(Entity &e, uint32_t simulateTime) 
+void on_disconnect(ENetPeer *peer)
 {
-  auto &snapshotsQueue = snapshotsHistory[eidToIndexInVectorMap[e.eid]];
-  Entity &ei = entitiesInputs[eidToIndexInVectorMap[e.eid]];
-  while (e.tick * fixedDt <= simulateTime) 
+  auto it = snapshotSchedulers.find(peer);
+  if (it == snapshotSchedulers.end()) {
+    return;
+  }
+  const uint16_t eid = it->second.controlledEntity();
+  snapshotSchedulers.erase(it);
+  controlledMap.erase(eid);
+
+  size_t index;
+  if (!world_entity_index(eid, index)) {
+    return;
+  }
+  world_remove_entity(eid);
+  for (auto &[otherPeer, scheduler] : snapshotSchedulers)
   {
-    ++e.tick;
-    while (!snapshotsQueue.empty() && snapshotsQueue.front().tick <= e.tick) {
-      ei = snapshotsQueue.front();
-      snapshotsQueue.pop();
-    }
-    if (e.tick >= ei.tick) {
-      e.thr = ei.thr; e.steer = ei.steer;
-    }
-    simulate_entity(e, fixedDt * 0.001f);
+    scheduler.removeEntity(index);
+    send_remove_entity(otherPeer, eid);
   }
 }
 
+void on_time_ping(const ENetEvent& event)
+{
+  uint32_t clientTime;
+  if (!deserialize_time_ping(event.packet, clientTime))
+    return;
+  send_time_pong(event.peer, clientTime, enet_time_get());
+}
+
 void on_input(const ENetEvent& event)
 {
-  ENetPacket *packet = event.packet;
+  static std::vector<EntityInputRun> runs;
   uint16_t eid = invalid_entity;
-  float thr = 0.f; float steer = 0.f;
-  uint32_t tick;
-  deserialize_entity_input(packet, eid, thr, steer, tick);
-  Entity ei;
-  uint32_t t = enet_time_get();
-  ei.tick = tick; //(t - event.peer->roundTripTime / 2 + FIXED_OFFSET + 1) / fixedDt + 1;
-  // if (ei.thr != thr || ei.steer != steer) {
-  //   std::cout << (t - event.peer->roundTripTime / 2 + FIXED_OFFSET + 1) << ' ' << tick  << ' ' << ei.tick << ' ' << tick / fixedDt + 1 << std::endl;
-  // }
-  ei.thr = thr;
-  ei.steer = steer;
-  snapshotsHistory[eidToIndexInVectorMap[eid]].push(ei);
-  simulate_entity_fixed(entities[eidToIndexInVectorMap[eid]], t); // вроде это помогает сделать более точную обработку, может все уже починилось и уже не надо
+  if (!deserialize_entity_input(event.packet, eid, runs) || runs.empty()) {
+    return;
+  }
+  // в пакете есть вводы за несколько последних тиков, мир берет только те, которых еще нет и которые еще не просимулированы
+  const uint32_t firstTick = world_tick() + 1;
+  const uint32_t lastTick = world_tick() + INPUT_HISTORY_SIZE - 1;
+  for (const EntityInputRun &run : runs)
+  {
+    const uint32_t runEnd = std::min<uint32_t>(run.tick + run.length - 1, lastTick);
+    for (uint32_t tick = std::max(run.tick, firstTick); tick <= runEnd; ++tick)
+      world_add_input(eid, tick, run.thr, run.steer);
+  }
+  // опоздавший ввод уже не применить к прошедшим тикам, поэтому он применяется на ближайшем тике
+  const EntityInputRun &newest = runs.front();
+  if (newest.tick + newest.length - 1 < firstTick) {
+    world_add_input(eid, firstTick, newest.thr, newest.steer);
+  }
 }
 
 
 int main(int argc, const char **argv)
 {
+  // --record <log>: писать появления сущностей и принятые вводы, чтобы потом воспроизвести мир в w5_replay
+  // --max-peers <N>: сколько клиентов держит сервер (для нагрузки w5_bot --clients)
+  size_t maxPeers = MAX_PEERS;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--max-peers") == 0)
+      maxPeers = static_cast<size_t>(std::clamp(atoi(argv[i + 1]), 1, int(ENET_PROTOCOL_MAXIMUM_PEER_ID)));
+    else if (strcmp(argv[i], "--record") == 0)
+    {
+      if (!recorder_open(argv[i + 1]))
+      {
+        printf("Cannot open recording %s\n", argv[i + 1]);
+        return 1;
+      }
+      printf("Recording to %s\n", argv[i + 1]);
+    }
+  }
+
+  NetStatsReporter netStats(message_type_name);
+  if (!netStats.openFromArgs(argc, argv))
+    return 1;
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w5_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -101,7 +140,7 @@ int main(int argc, const char **argv)
   address.host = ENET_HOST_ANY;
   address.port = 10131;
 
-  ENetHost *server = enet_host_create(&address, 32, 2, 0, 0);
+  ENetHost *server = enet_host_create(&address, maxPeers, 2, 0, 0);
 
   if (!server)
   {
@@ -109,30 +148,43 @@ int main(int argc, const char **argv)
     return 1;
   }
 
+  TickWaiter tickWaiter;
+  if (!tickWaiter.init(server->socket))
+  {
+    printf("Cannot init tick waiter\n");
+    return 1;
+  }
+  TickStats tickStats;
+
   enet_time_set(0);
-  uint32_t lastTime = enet_time_get();
-  uint32_t lastTimeSendSnapshots = enet_time_get();
+  uint32_t lastTimeTickStats = enet_time_get();
   while (true)
   {
-    uint32_t curTime = enet_time_get();
-    lastTime = curTime;
     ENetEvent event;
-    while (enet_host_service(server, &event, 1) > 0)
+    while (enet_host_service(server, &event, 0) > 0)
     {
       switch (event.type)
       {
       case ENET_EVENT_TYPE_CONNECT:
         printf("Connection with %x:%u established\n", event.peer->address.host, event.peer->address.port);
         break;
+      case ENET_EVENT_TYPE_DISCONNECT:
+        printf("%x:%u disconnected\n", event.peer->address.host, event.peer->address.port);
+        on_disconnect(event.peer);
+        break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
           case E_CLIENT_TO_SERVER_JOIN:
-            on_join(event.packet, event.peer, server, curTime);
+            on_join(event.packet, event.peer, server);
             break;
           case E_CLIENT_TO_SERVER_INPUT:
             on_input(event);
             break;
+          case E_CLIENT_TO_SERVER_TIME_PING:
+            on_time_ping(event);
+            break;
         };
         enet_packet_destroy(event.packet);
         break;
@@ -141,30 +193,41 @@ int main(int argc, const char **argv)
       };
     }
 
-    curTime = enet_time_get();
-    for (Entity &e : entities)
-    {
-      simulate_entity_fixed(e, curTime);
-    }
-
-    if (curTime - lastTimeSendSnapshots >= SEND_TIMEOUT) {
-      for (Entity &e : entities)
+    uint32_t curTime = enet_time_get();
+    const uint32_t firstTick = world_tick() + 1;
+    world_simulate(curTime);
+    const uint32_t steps = world_tick() + 1 - firstTick;
+    tickStats.onStep(curTime, firstTick, steps);
+
+    // каждому пиру в тик уходят самые нужные ему снепшоты, сколько позволяет его канал
+    if (steps > 0) {
+      static std::vector<size_t> toSend;
+      for (auto &[peer, scheduler] : snapshotSchedulers)
       {
-        // send
-        for (size_t i = 0; i < server->connectedPeers; ++i)
-        {
-          ENetPeer *peer = &server->peers[i];
-          // skip this here in this implementation
-          //if (controlledMap[e.eid] != peer)
-          send_snapshot(peer, e);
-        }
+        size_t viewerIndex = SIZE_MAX;
+        world_entity_index(scheduler.controlledEntity(), viewerIndex);
+        scheduler.updateLink(*peer, curTime, steps * fixedDt);
+        scheduler.schedule(world_state(), viewerIndex, steps * fixedDt, toSend);
+        for (size_t entityIndex : toSend)
+          send_snapshot(peer, world_get_entity(entityIndex));
       }
-      lastTimeSendSnapshots = curTime;
+      enet_host_flush(server);
     }
-    // usleep(100000);
+
+    netStats.update(curTime);
+
+    if (curTime - lastTimeTickStats >= TICK_STATS_INTERVAL) {
+      tickStats.print();
+      tickStats.reset();
+      lastTimeTickStats = curTime;
+    }
+
+    // сон до следующего тика (снепшоты тоже рассылаются по тикам) либо до прихода пакета
+    tickWaiter.wait(world_tick() * fixedDt);
   }
 
   enet_host_destroy(server);
+  recorder_close();
 
   atexit(enet_deinitialize);
   return 0;
@@ -0,0 +1,167 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+// Отображение 16-битных идентификаторов сущностей в плотные индексы параллельных массивов.
+// Идентификатор = поколение << log2(Capacity) | ячейка: поиск - одно обращение к массиву ячеек и сравнение поколения,
+// после удаления ячейка переиспользуется с новым поколением, и старый идентификатор перестает находиться.
+// Плотные индексы идут подряд [0, size()): удаление переносит последний элемент на место удаленного,
+// владелец параллельных массивов делает с ними то же самое (swap_remove).
+template<uint32_t Capacity>
+class SlotMap {
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0 && Capacity <= (1u << 15),
+                  "Capacity must be a power of two, leaving at least one bit for generation");
+
+ public:
+    static constexpr uint16_t INVALID_HANDLE = UINT16_MAX;
+
+    SlotMap() {
+        clear();
+    }
+
+    // Выдает новый идентификатор и добавляет его в конец плотных массивов. INVALID_HANDLE, если ячейки кончились
+    uint16_t create() {
+        uint32_t slot;
+        if (!m_freeSlots.empty()) {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        } else if (m_nextUnusedSlot < Capacity) {
+            slot = m_nextUnusedSlot++;
+        } else {
+            return INVALID_HANDLE;
+        }
+        const uint16_t handle = makeHandle(slot, m_slots[slot].generation);
+        occupy(slot, handle);
+        return handle;
+    }
+
+    // Добавляет идентификатор, выданный кем-то другим (клиент получает их от сервера). false, если ячейка занята
+    bool insert(uint16_t handle) {
+        if (handle == INVALID_HANDLE) {
+            return false;
+        }
+        const uint32_t slot = slotOf(handle);
+        if (m_slots[slot].denseIndex != INVALID_INDEX) {
+            return false;
+        }
+        m_slots[slot].generation = generationOf(handle);
+        occupy(slot, handle);
+        return true;
+    }
+
+    bool find(uint16_t handle, size_t &index) const {
+        if (handle == INVALID_HANDLE) {
+            return false;
+        }
+        const Slot &s = m_slots[slotOf(handle)];
+        if (s.denseIndex == INVALID_INDEX || s.generation != generationOf(handle)) {
+            return false;
+        }
+        index = s.denseIndex;
+        return true;
+    }
+
+    bool contains(uint16_t handle) const {
+        size_t index;
+        return find(handle, index);
+    }
+
+    // Удаляет идентификатор. index - плотный индекс, на который переехал последний элемент (если удален не он сам)
+    bool erase(uint16_t handle, size_t &index) {
+        if (!find(handle, index)) {
+            return false;
+        }
+        const uint32_t slot = slotOf(handle);
+        const uint16_t lastHandle = m_handles.back();
+        m_handles[index] = lastHandle;
+        m_slots[slotOf(lastHandle)].denseIndex = static_cast<uint32_t>(index);
+        m_handles.pop_back();
+
+        m_slots[slot].denseIndex = INVALID_INDEX;
+        m_slots[slot].generation = nextGeneration(slot, m_slots[slot].generation);
+        m_freeSlots.push_back(slot);
+        return true;
+    }
+
+    size_t size() const {
+        return m_handles.size();
+    }
+
+    bool empty() const {
+        return m_handles.empty();
+    }
+
+    uint16_t handle(size_t index) const {
+        assert(index < m_handles.size());
+        return m_handles[index];
+    }
+
+    // Идентификаторы в порядке плотных индексов
+    const std::vector<uint16_t>& handles() const {
+        return m_handles;
+    }
+
+    void clear() {
+        for (Slot &s : m_slots) {
+            s.denseIndex = INVALID_INDEX;
+            s.generation = 0;
+        }
+        m_handles.clear();
+        m_freeSlots.clear();
+        m_nextUnusedSlot = 0;
+    }
+
+ private:
+    struct Slot
+    {
+        uint32_t denseIndex;
+        uint16_t generation;
+    };
+
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+    static constexpr uint32_t SLOT_BITS = std::countr_zero(Capacity);
+    static constexpr uint16_t MAX_GENERATION = (1u << (16 - SLOT_BITS)) - 1;
+
+    static uint32_t slotOf(uint16_t handle) {
+        return handle & (Capacity - 1);
+    }
+
+    static uint16_t generationOf(uint16_t handle) {
+        return handle >> SLOT_BITS;
+    }
+
+    static uint16_t makeHandle(uint32_t slot, uint16_t generation) {
+        return static_cast<uint16_t>((generation << SLOT_BITS) | slot);
+    }
+
+    // Поколение идет по кругу, пропуская значение, при котором идентификатор совпал бы с INVALID_HANDLE
+    static uint16_t nextGeneration(uint32_t slot, uint16_t generation) {
+        generation = generation == MAX_GENERATION ? 0 : generation + 1;
+        return makeHandle(slot, generation) == INVALID_HANDLE ? 0 : generation;
+    }
+
+    void occupy(uint32_t slot, uint16_t handle) {
+        m_slots[slot].denseIndex = static_cast<uint32_t>(m_handles.size());
+        m_handles.push_back(handle);
+    }
+
+    std::array<Slot, Capacity> m_slots;
+    std::vector<uint16_t> m_handles;
+    std::vector<uint32_t> m_freeSlots;
+    uint32_t m_nextUnusedSlot;
+};
+
+// Удаление из параллельного массива так же, как в SlotMap::erase: последний элемент встает на место удаленного
+template<typename T>
+void swap_remove(std::vector<T> &v, size_t index) {
+    assert(index < v.size());
+    if (index + 1 != v.size()) {
+        v[index] = std::move(v.back());
+    }
+    v.pop_back();
+}
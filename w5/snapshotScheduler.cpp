@@ -0,0 +1,72 @@
+#include "snapshotScheduler.h"
+#include "params.h"
+#include "protocol.h"
+#include "slotMap.h"
+#include <algorithm>
+#include <math.h>
+
+void SnapshotScheduler::updateLink(const ENetPeer &peer, uint32_t curTime, uint32_t dt)
+{
+  const uint32_t rtt = peer.roundTripTime;
+  m_minRtt = std::min(m_minRtt, rtt);
+  const bool congested = peer.packetLoss > LOSS_THRESHOLD || rtt > m_minRtt * 2 + RTT_SLACK;
+  if (congested) {
+    if (curTime - m_lastDecrease >= rtt) {
+      m_bandwidth = std::max(m_bandwidth * BANDWIDTH_DECREASE, MIN_BANDWIDTH);
+      m_lastDecrease = curTime;
+    }
+  } else {
+    m_bandwidth = std::min(m_bandwidth + BANDWIDTH_INCREASE * dt * 0.001, MAX_BANDWIDTH);
+  }
+
+  const double throttle = static_cast<double>(peer.packetThrottle) / static_cast<double>(ENET_PEER_PACKET_THROTTLE_SCALE);
+  const double rate = m_bandwidth * std::min(throttle, 1.0);
+  m_budget = std::min(m_budget + rate * dt * 0.001, std::max(rate * BURST_TICKS * fixedDt * 0.001, double(SNAPSHOT_WIRE_SIZE)));
+}
+
+void SnapshotScheduler::removeEntity(size_t index)
+{
+  if (index < m_priority.size()) {
+    swap_remove(m_priority, index);
+  }
+}
+
+void SnapshotScheduler::schedule(const EntitiesState &state, size_t viewerIndex, uint32_t dt, std::vector<size_t> &toSend)
+{
+  toSend.clear();
+  const size_t n = state.size();
+  m_priority.resize(n, 1.f); // новые сущности уходят первыми
+  const bool hasViewer = viewerIndex < n;
+  const float viewerX = hasViewer ? state.x[viewerIndex] : 0.f;
+  const float viewerY = hasViewer ? state.y[viewerIndex] : 0.f;
+  const float step = static_cast<float>(dt) / SEND_TIMEOUT;
+
+  m_candidates.clear();
+  for (size_t i = 0; i < n; ++i)
+  {
+    float weight = 1.f + SPEED_WEIGHT * fabsf(state.speed[i]) * 0.1f;
+    if (i == viewerIndex) {
+      weight *= CONTROLLED_WEIGHT;
+    } else if (hasViewer) {
+      const float dx = state.x[i] - viewerX;
+      const float dy = state.y[i] - viewerY;
+      weight += NEAR_WEIGHT / (1.f + sqrtf(dx * dx + dy * dy) / NEAR_DISTANCE);
+    }
+    m_priority[i] += weight * step;
+    if (m_priority[i] >= MIN_SEND_PRIORITY) {
+      m_candidates.push_back(i);
+    }
+  }
+
+  std::sort(m_candidates.begin(), m_candidates.end(), [this](size_t a, size_t b) { return m_priority[a] > m_priority[b]; });
+  for (size_t i : m_candidates)
+  {
+    if (m_budget < SNAPSHOT_WIRE_SIZE) {
+      break;
+    }
+    m_budget -= SNAPSHOT_WIRE_SIZE;
+    m_priority[i] = 0.f;
+    toSend.push_back(i);
+  }
+  m_sentSnapshots += static_cast<uint32_t>(toSend.size());
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <enet/enet.h>
+#include "entity.h"
+
+// Расписание снепшотов для одного соединения.
+// Пропускная способность оценивается AIMD: медленно растет, пока rtt близок к минимальному и потерь нет,
+// и сбрасывается на четверть не чаще раза в rtt при потерях или раздувшемся rtt; затем режется текущим throttle ENet,
+// который все равно выбросил бы лишние ненадежные пакеты. Из нее каждый тик пополняется бюджет в байтах.
+// У каждой сущности копится приоритет: обычная набирает порог отправки ровно за SEND_TIMEOUT, своя сущность,
+// ближние к ней и быстро движущиеся - быстрее, вплоть до каждого тика. В тик отправляются набравшие порог
+// сущности с наибольшим приоритетом, пока хватает бюджета, и их приоритет сбрасывается.
+// На хорошем канале частоту задают приоритеты, на медленном - бюджет, и канал не переполняется
+class SnapshotScheduler
+{
+ public:
+    void setControlledEntity(uint16_t eid) { m_controlledEntity = eid; }
+    uint16_t controlledEntity() const { return m_controlledEntity; }
+
+    // Сущность с индексом index удалена из мира, на ее место переехала последняя
+    void removeEntity(size_t index);
+
+    // Раз в тик: оценка канала по состоянию пира и пополнение бюджета за dt мс
+    void updateLink(const ENetPeer &peer, uint32_t curTime, uint32_t dt);
+
+    // Индексы сущностей, которые надо отправить в этом тике. viewerIndex - индекс своей сущности пира или SIZE_MAX
+    void schedule(const EntitiesState &state, size_t viewerIndex, uint32_t dt, std::vector<size_t> &toSend);
+
+    // байт/с
+    uint32_t bandwidth() const { return static_cast<uint32_t>(m_bandwidth); }
+    uint32_t sentSnapshots() const { return m_sentSnapshots; }
+
+ private:
+    static constexpr double INITIAL_BANDWIDTH = 16 * 1024.0;
+    static constexpr double MIN_BANDWIDTH = 2 * 1024.0;
+    static constexpr double MAX_BANDWIDTH = 256 * 1024.0;
+    static constexpr double BANDWIDTH_INCREASE = 8 * 1024.0;   // байт/с за секунду без перегрузки
+    static constexpr double BANDWIDTH_DECREASE = 0.75;
+    static constexpr uint32_t LOSS_THRESHOLD = ENET_PEER_PACKET_LOSS_SCALE / 50; // 2%
+    static constexpr uint32_t RTT_SLACK = 20;                  // мс сверх удвоенного минимального rtt
+    static constexpr uint32_t BURST_TICKS = 2;                 // бюджет не копится больше чем на столько тиков
+
+    static constexpr float CONTROLLED_WEIGHT = 4.f;
+    static constexpr float SPEED_WEIGHT = 1.f;                 // при скорости 10 ед/с
+    static constexpr float NEAR_WEIGHT = 2.f;
+    static constexpr float NEAR_DISTANCE = 10.f;
+    static constexpr float MIN_SEND_PRIORITY = 1.f;            // обычная сущность набирает его за SEND_TIMEOUT
+
+    uint16_t m_controlledEntity = invalid_entity;
+    double m_bandwidth = INITIAL_BANDWIDTH;
+    double m_budget = 0.0;
+    uint32_t m_minRtt = UINT32_MAX;
+    uint32_t m_lastDecrease = 0;
+    uint32_t m_sentSnapshots = 0;
+    std::vector<float> m_priority;
+    std::vector<size_t> m_candidates;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Очередь фиксированного размера без блокировок для ровно одного писателя и одного читателя (разные потоки).
+// Писатель двигает только m_tail, читатель только m_head, поэтому хватает acquire/release без CAS.
+// Индексы растут неограниченно, ячейка = индекс & (Capacity - 1); head и tail в разных кеш-линиях, чтобы потоки не мешали друг другу
+template<typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+    // Только из потока писателя. false, если очередь полна
+    bool tryPush(const T &value) {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == Capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == Capacity) {
+                return false;
+            }
+        }
+        m_values[tail & (Capacity - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Только из потока читателя. false, если очередь пуста
+    bool tryPop(T &value) {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return false;
+            }
+        }
+        value = m_values[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+ private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::atomic<uint32_t> m_head{0};
+    uint32_t m_cachedTail = 0;  // последний увиденный читателем tail
+    alignas(CACHE_LINE) std::atomic<uint32_t> m_tail{0};
+    uint32_t m_cachedHead = 0;  // последний увиденный писателем head
+    alignas(CACHE_LINE) std::array<T, Capacity> m_values{};
+};
@@ -0,0 +1,90 @@
+#include "tickWaiter.h"
+#include "params.h"
+#include <algorithm>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+TickWaiter::~TickWaiter()
+{
+#ifdef __linux__
+  if (m_timer >= 0)
+    close(m_timer);
+  if (m_epoll >= 0)
+    close(m_epoll);
+#endif
+}
+
+bool TickWaiter::init(ENetSocket socket)
+{
+  m_socket = socket;
+#ifdef __linux__
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m_epoll < 0 || m_timer < 0)
+    return false;
+  epoll_event socketEvent{};
+  socketEvent.events = EPOLLIN;
+  socketEvent.data.fd = socket;
+  epoll_event timerEvent{};
+  timerEvent.events = EPOLLIN;
+  timerEvent.data.fd = m_timer;
+  return epoll_ctl(m_epoll, EPOLL_CTL_ADD, socket, &socketEvent) == 0 &&
+         epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &timerEvent) == 0;
+#else
+  return true;
+#endif
+}
+
+void TickWaiter::wait(uint32_t deadline)
+{
+  const int32_t timeout = static_cast<int32_t>(deadline - enet_time_get());
+  if (timeout <= 0)
+    return;
+#ifdef __linux__
+  // срок в часах ENet (миллисекунды), поэтому таймер взводится относительно текущего момента
+  itimerspec spec{};
+  spec.it_value.tv_sec = timeout / 1000;
+  spec.it_value.tv_nsec = (timeout % 1000) * 1000000L;
+  timerfd_settime(m_timer, 0, &spec, nullptr);
+
+  epoll_event events[2];
+  const int nEvents = epoll_wait(m_epoll, events, 2, -1);
+  for (int i = 0; i < nEvents; ++i)
+  {
+    if (events[i].data.fd == m_timer)
+    {
+      uint64_t expirations;
+      if (read(m_timer, &expirations, sizeof(expirations)) < 0)
+        continue;
+    }
+  }
+#else
+  enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+  enet_socket_wait(m_socket, &condition, static_cast<enet_uint32>(timeout));
+#endif
+}
+
+void TickStats::onStep(uint32_t curTime, uint32_t firstTick, uint32_t steps)
+{
+  if (steps == 0)
+    return;
+  // тик firstTick считается, как только время дошло до (firstTick - 1) * fixedDt
+  const uint32_t lateness = curTime - (firstTick - 1) * fixedDt;
+  ticks += steps;
+  catchUpTicks += steps - 1;
+  lateTicks += lateness > 1 ? 1 : 0;
+  maxLateness = std::max(maxLateness, lateness);
+  totalLateness += lateness;
+}
+
+void TickStats::print() const
+{
+  const uint32_t wakeups = ticks - catchUpTicks;
+  printf("%u ticks: %u late, %u catch-up, lateness avg %.2f ms max %u ms\n", ticks, lateTicks, catchUpTicks,
+         wakeups > 0 ? double(totalLateness) / wakeups : 0.0, maxLateness);
+}
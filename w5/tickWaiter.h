@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <enet/enet.h>
+
+// Ожидание следующего дела сервера без опроса: пакета на сокете ENet или наступления срока (тика мира, рассылки снепшотов).
+// На Linux ждет в epoll сокет хоста вместе с timerfd, заведенным ровно на срок, иначе через enet_socket_wait с таймаутом до срока.
+// В простое сервер спит до границы тика, а не просыпается каждую миллисекунду
+class TickWaiter
+{
+ public:
+    TickWaiter() = default;
+    ~TickWaiter();
+    TickWaiter(const TickWaiter&) = delete;
+    TickWaiter& operator=(const TickWaiter&) = delete;
+
+    bool init(ENetSocket socket);
+
+    // Возвращает, когда на сокете есть данные или enet_time_get() дошло до deadline
+    void wait(uint32_t deadline);
+
+ private:
+    ENetSocket m_socket{};
+    int m_epoll = -1;
+    int m_timer = -1;
+};
+
+// Насколько точно тики мира идут по своим границам
+struct TickStats
+{
+  uint32_t ticks = 0;
+  uint32_t lateTicks = 0;      // тиков, начатых позже своей границы больше чем на 1 мс
+  uint32_t catchUpTicks = 0;   // тиков, досчитанных подряд за одно пробуждение, потому что предыдущие не успели
+  uint32_t maxLateness = 0;    // мс
+  uint64_t totalLateness = 0;  // мс
+
+  // curTime - время пробуждения, firstTick - первый тик, который мир досчитал за это пробуждение
+  void onStep(uint32_t curTime, uint32_t firstTick, uint32_t steps);
+  void print() const;
+  void reset() { *this = TickStats(); }
+};
@@ -0,0 +1,148 @@
+#include "world.h"
+#include <vector>
+
+#include "params.h"
+#include "ringBuffer.h"
+#include "slotMap.h"
+#include "recorder.h"
+
+static std::vector<Entity> entities; // цвет и eid, актуальное состояние в entitiesState
+static EntitiesState entitiesState;
+static uint32_t worldTick = 0;
+static WorldHistory<LAG_COMPENSATION_HISTORY_SIZE> worldHistory(LAG_COMPENSATION_MAX_ENTITIES);
+static SlotMap<ENTITY_SLOTS> entityIds; // eid -> индекс в entities, entitiesState и inputsHistory
+static std::vector<TickRingBuffer<Entity, INPUT_HISTORY_SIZE>> inputsHistory;
+
+uint32_t world_tick()
+{
+  return worldTick;
+}
+
+size_t world_entities_count()
+{
+  return entities.size();
+}
+
+uint16_t world_add_entity(Entity e)
+{
+  e.eid = entityIds.create();
+  if (e.eid == invalid_entity) {
+    return invalid_entity;
+  }
+  entities.push_back(e);
+  entitiesState.push_back(e);
+  inputsHistory.emplace_back();
+  record_join(worldTick, e);
+  return e.eid;
+}
+
+bool world_remove_entity(uint16_t eid)
+{
+  size_t index;
+  if (!entityIds.erase(eid, index)) {
+    return false;
+  }
+  const size_t lastIndex = entities.size() - 1;
+  swap_remove(entities, index);
+  entitiesState.swapRemove(index);
+  swap_remove(inputsHistory, index);
+  worldHistory.swapRemove(index, lastIndex);
+  record_leave(worldTick, eid);
+  return true;
+}
+
+const EntitiesState& world_state()
+{
+  return entitiesState;
+}
+
+bool world_entity_index(uint16_t eid, size_t &index)
+{
+  return entityIds.find(eid, index);
+}
+
+Entity world_get_entity(size_t index)
+{
+  Entity e = entities[index];
+  entitiesState.load(index, e);
+  e.tick = worldTick;
+  return e;
+}
+
+bool world_add_input(uint16_t eid, uint32_t tick, float thr, float steer)
+{
+  size_t index;
+  if (!entityIds.find(eid, index) || tick <= worldTick || tick >= worldTick + INPUT_HISTORY_SIZE) {
+    return false;
+  }
+  auto &history = inputsHistory[index];
+  if (history.contains(tick)) {
+    return false;
+  }
+  Entity ei;
+  ei.thr = thr;
+  ei.steer = steer;
+  ei.tick = tick;
+  history.insert(tick, ei);
+  record_input(worldTick, eid, tick, thr, steer);
+  return true;
+}
+
+static void apply_inputs(uint32_t tick)
+{
+  for (size_t i = 0; i < inputsHistory.size(); ++i)
+  {
+    auto &history = inputsHistory[i];
+    while (!history.empty() && history.frontTick() <= tick) {
+      const Entity &ei = history.front();
+      entitiesState.thr[i] = ei.thr;
+      entitiesState.steer[i] = ei.steer;
+      history.popFront();
+    }
+  }
+}
+
+void world_step()
+{
+  ++worldTick;
+  apply_inputs(worldTick);
+  simulate_entities(entitiesState, fixedDt * 0.001f);
+  worldHistory.record(worldTick, entitiesState, entityIds.handles().data());
+  if (worldTick % WORLD_HASH_INTERVAL == 0) {
+    record_hash(worldTick, world_state_hash());
+  }
+}
+
+void world_simulate(uint32_t simulateTime)
+{
+  while (worldTick * fixedDt <= simulateTime)
+  {
+    world_step();
+  }
+}
+
+uint32_t world_state_hash()
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < entities.size(); ++i)
+  {
+    hash = (hash ^ entity_state_hash(world_get_entity(i))) * 16777619u;
+  }
+  return hash;
+}
+
+bool world_rewind_entity(uint16_t eid, uint32_t tick, EntityTransform &transform)
+{
+  size_t index;
+  return entityIds.find(eid, index) && worldHistory.rewind(tick, index, eid, transform);
+}
+
+void world_reset()
+{
+  entities.clear();
+  entitiesState = EntitiesState();
+  worldTick = 0;
+  worldHistory = WorldHistory<LAG_COMPENSATION_HISTORY_SIZE>(LAG_COMPENSATION_MAX_ENTITIES);
+  entityIds.clear();
+  inputsHistory.clear();
+}
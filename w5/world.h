@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "entity.h"
+#include "worldHistory.h"
+
+// Авторитетная симуляция мира на сервере без привязки к сети: ее же гоняет w5_replay по записанному логу.
+// Мир живет фиксированными тиками: на тике сначала применяются все вводы, пришедшие на этот тик,
+// затем все сущности продвигаются на один тик одним проходом.
+
+uint32_t world_tick();
+size_t world_entities_count();
+// Добавляет сущность и выдает ей eid (e.eid не используется), invalid_entity если мир полон
+uint16_t world_add_entity(Entity e);
+// На индекс удаленной сущности переезжает последняя
+bool world_remove_entity(uint16_t eid);
+const EntitiesState& world_state();
+bool world_entity_index(uint16_t eid, size_t &index);
+// Состояние сущности с индексом index на текущем тике
+Entity world_get_entity(size_t index);
+
+// Ввод сущности eid на тик tick. Берется, только если тик еще не просимулирован, влезает в окно истории вводов
+// и ввода на этот тик еще нет (один и тот же тик приходит в нескольких пакетах)
+bool world_add_input(uint16_t eid, uint32_t tick, float thr, float steer);
+
+void world_step();
+// Продвигает мир до времени simulateTime
+void world_simulate(uint32_t simulateTime);
+
+uint32_t world_state_hash();
+// Где была сущность на прошедшем тике (например, на тике, который видел игрок с большим rtt)
+bool world_rewind_entity(uint16_t eid, uint32_t tick, EntityTransform &transform);
+
+void world_reset();
@@ -0,0 +1,124 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "entity.h"
+#include "fixedMath.h"
+
+struct EntityTransform
+{
+  float x = 0.f;
+  float y = 0.f;
+  float ori = 0.f;
+};
+
+// История положений всех сущностей за последние Capacity тиков для компенсации лага на сервере:
+// позволяет ответить, где была сущность на тике, который видел клиент с большим rtt.
+// Хранятся x, y в Q16.16 (весь диапазон симуляции +-32767, точно те значения, что дает fx_from_float),
+// квантованный ori (1/65536 оборота) и eid - 12 байт на сущность в тик,
+// eid нужен, чтобы после удаления сущности (на ее индекс переезжает последняя) не отдать чужое положение.
+// Память ограничена Capacity * maxEntities кадров и не растет после того, как число сущностей перестало расти.
+template<uint32_t Capacity>
+class WorldHistory
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+    explicit WorldHistory(size_t maxEntities) : m_maxEntities(maxEntities) {
+        m_frameTicks.fill(INVALID_TICK);
+        m_frameSizes.fill(0);
+    }
+
+    // eids[i] - идентификатор сущности с индексом i
+    void record(uint32_t tick, const EntitiesState &state, const uint16_t *eids) {
+        const size_t count = std::min(state.size(), m_maxEntities);
+        if (count > m_stride) {
+            grow(count);
+        }
+        const uint32_t frame = slot(tick);
+        PackedTransform *transforms = m_transforms.data() + frame * m_stride;
+        for (size_t i = 0; i < count; ++i) {
+            transforms[i] = pack(state.x[i], state.y[i], state.ori[i], eids[i]);
+        }
+        m_frameTicks[frame] = tick;
+        m_frameSizes[frame] = static_cast<uint32_t>(count);
+    }
+
+    bool contains(uint32_t tick) const {
+        return m_frameTicks[slot(tick)] == tick;
+    }
+
+    // O(1): положение сущности eid с индексом entityIndex на тике tick, false если тик уже вытеснен или сущности тогда не было
+    bool rewind(uint32_t tick, size_t entityIndex, uint16_t eid, EntityTransform &transform) const {
+        const uint32_t frame = slot(tick);
+        if (m_frameTicks[frame] != tick || entityIndex >= m_frameSizes[frame]) {
+            return false;
+        }
+        const PackedTransform &packed = m_transforms[frame * m_stride + entityIndex];
+        if (packed.eid != eid) {
+            return false;
+        }
+        transform = unpack(packed);
+        return true;
+    }
+
+    // Сущность с индексом lastIndex переехала на index (swap_remove): ее прошлые положения переезжают вместе с ней
+    void swapRemove(size_t index, size_t lastIndex) {
+        for (uint32_t frame = 0; frame < Capacity; ++frame) {
+            PackedTransform *transforms = m_transforms.data() + frame * m_stride;
+            if (lastIndex < m_frameSizes[frame]) {
+                transforms[index] = transforms[lastIndex];
+                m_frameSizes[frame] = static_cast<uint32_t>(lastIndex);
+            }
+        }
+    }
+
+    size_t memoryUsage() const {
+        return m_transforms.capacity() * sizeof(PackedTransform) + sizeof(*this);
+    }
+
+ private:
+    struct PackedTransform
+    {
+        fixed x;
+        fixed y;
+        uint16_t ori;
+        uint16_t eid;
+    };
+
+    static PackedTransform pack(float x, float y, float ori, uint16_t eid) {
+        return {fx_from_float(x), fx_from_float(y), static_cast<uint16_t>(fx_radians_to_angle(fx_from_float(ori))), eid};
+    }
+
+    static EntityTransform unpack(const PackedTransform &packed) {
+        EntityTransform transform;
+        transform.x = fx_to_float(packed.x);
+        transform.y = fx_to_float(packed.y);
+        // угол возвращается в [-PI, PI)
+        transform.ori = static_cast<int16_t>(packed.ori) * (2.f * 3.141592654f / 65536.f);
+        return transform;
+    }
+
+    static uint32_t slot(uint32_t tick) {
+        return tick & (Capacity - 1);
+    }
+
+    void grow(size_t count) {
+        const size_t newStride = std::min(std::max(count, m_stride * 2), m_maxEntities);
+        std::vector<PackedTransform> transforms(Capacity * newStride);
+        for (uint32_t frame = 0; frame < Capacity; ++frame) {
+            std::copy_n(m_transforms.data() + frame * m_stride, m_frameSizes[frame], transforms.data() + frame * newStride);
+        }
+        m_transforms.swap(transforms);
+        m_stride = newStride;
+    }
+
+    static constexpr uint32_t INVALID_TICK = UINT32_MAX;
+    std::array<uint32_t, Capacity> m_frameTicks;
+    std::array<uint32_t, Capacity> m_frameSizes;
+    std::vector<PackedTransform> m_transforms;
+    size_t m_stride = 0;
+    size_t m_maxEntities;
+};
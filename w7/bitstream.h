@@ -1,9 +1,12 @@
+#pragma once
 #include <cstdint>
 #include <vector>
 #include <cstring>
 #include <cassert>
 #include <iostream>
 #include <bitset>
+#include <type_traits>
+#include "varint.h"
 
 class BitstreamWriter {
  public:
@@ -19,6 +22,8 @@ class BitstreamWriter {
         m_bufferSize = other.m_bufferSize;
         m_currentPos = other.m_currentPos;
         m_buffer = other.m_buffer;
+        m_bits = other.m_bits;
+        m_bitsCount = other.m_bitsCount;
 
         m_bufferSize = 0;
         m_currentPos = 0;
@@ -36,43 +41,52 @@ class BitstreamWriter {
 
     template<typename... Args>
     void write(const Args&... values) {
-        constexpr uint32_t dataSize = (sizeof(Args) + ... + 0);
-        reallocateIfNeed(m_currentPos + dataSize);
-        writeValuesPackInBuffer(&m_buffer[m_currentPos], values...);
-        m_currentPos += dataSize;
+        assert(m_bitsCount == 0 && "call alignToByte() before byte writes");
+        append(values...);
     }
 
     void writeData(const char* data, uint32_t dataSize) {
+        assert(m_bitsCount == 0 && "call alignToByte() before byte writes");
         reallocateIfNeed(m_currentPos + dataSize);
         memcpy(&m_buffer[m_currentPos], data, dataSize);
         m_currentPos += dataSize;
     }
 
-    void writePackedUint32(uint32_t value) {
-        constexpr int n_chooseSizeBits = 2;
-        // constexpr uint8_t uint8Indicator   = 0b00000000;
-        constexpr uint16_t uint16Indicator = 0b01000000;
-        constexpr uint32_t uint32Indicator = 0b10000000;
-        assert(value < (1 << (32 - n_chooseSizeBits)));
-        // std::cout << std::bitset<32>(value) << std::endl;
-        if (value < (1 << (8 - n_chooseSizeBits))) {
-            const uint8_t packedValue = static_cast<uint8_t>(value); // | uint8Indicator
-            write(packedValue); 
+    // Целое переменной длины (varint.h): 1 байт до 2^7, 2 до 2^14, ..., 9 байт на любое 64-битное
+    void writeVarUint(uint64_t value) {
+        assert(m_bitsCount == 0 && "call alignToByte() before byte writes");
+        reallocateIfNeed(m_currentPos + VARINT_MAX_SIZE);
+        m_currentPos += varint_encode(value, reinterpret_cast<uint8_t*>(&m_buffer[m_currentPos]));
+    }
+
+    // Знаковое через zigzag: малые по модулю разности любого знака занимают 1 байт
+    void writeVarInt(int64_t value) {
+        writeVarUint(zigzag_encode(value));
+    }
+
+    // Побитовая запись: младшие numBits бит value, начиная с младших битов очередного байта.
+    // Биты копятся в 64-битном регистре и уходят в буфер по 4 байта
+    void writeBits(uint32_t value, int numBits) {
+        assert(numBits > 0 && numBits <= 32);
+        const uint64_t mask = (uint64_t(1) << numBits) - 1;
+        m_bits |= (value & mask) << m_bitsCount;
+        m_bitsCount += numBits;
+        if (m_bitsCount >= 32) {
+            append(static_cast<uint8_t>(m_bits), static_cast<uint8_t>(m_bits >> 8),
+                   static_cast<uint8_t>(m_bits >> 16), static_cast<uint8_t>(m_bits >> 24));
+            m_bits >>= 32;
+            m_bitsCount -= 32;
         }
-        else if (value < (1 << (16 - n_chooseSizeBits))) {
-            const uint8_t packedValueFirstByte = static_cast<uint8_t>(value >> 8) | uint16Indicator;
-            const uint8_t packedValueSecondByte = static_cast<uint8_t>(value & ((1 << 8) - 1));
-            write(packedValueFirstByte, packedValueSecondByte);
+    }
+
+    // Дописывает недозаполненный байт нулями, после этого снова можно писать побайтово
+    void alignToByte() {
+        for (; m_bitsCount > 0; m_bitsCount -= 8) {
+            append(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
         }
-        else {
-            // записываю и считываю по байту потому что байты могут по разному располагаться в памяти в разных системах
-            // вот у меня задом наперед, может щас везде задом наперед располагаются, но я не уверен поэтому так делаю
-            const uint8_t packedValueFirstByte = static_cast<uint8_t>(value >> 24) | uint32Indicator;
-            const uint8_t packedValueSecondByte = static_cast<uint8_t>((value >> 16) & ((1 << 8) - 1));
-            const uint8_t packedValueThirdByte = static_cast<uint8_t>((value >> 8) & ((1 << 8) - 1));
-            const uint8_t packedValueFourthByte = static_cast<uint8_t>(value & ((1 << 8) - 1));
-            write(packedValueFirstByte, packedValueSecondByte, packedValueThirdByte, packedValueFourthByte);
-        } 
+        m_bits = 0;
+        m_bitsCount = 0;
     }
 
     char* data() {
@@ -84,6 +98,14 @@ class BitstreamWriter {
     }
 
  private:
+    template<typename... Args>
+    void append(const Args&... values) {
+        constexpr uint32_t dataSize = (sizeof(Args) + ... + 0);
+        reallocateIfNeed(m_currentPos + dataSize);
+        writeValuesPackInBuffer(&m_buffer[m_currentPos], values...);
+        m_currentPos += dataSize;
+    }
+
     template<typename T, typename... Args>
     void writeValuesPackInBuffer(char* position, const T& value, const Args&... values) {
         memcpy(position, &value, sizeof(T));
@@ -119,6 +141,8 @@ class BitstreamWriter {
     char* m_buffer = nullptr;
     uint32_t m_bufferSize = 0;
     uint32_t m_currentPos = 0;
+    uint64_t m_bits = 0;  // еще не записанные в буфер биты writeBits
+    int m_bitsCount = 0;
 };
 
 class BitstreamReader {
@@ -139,37 +163,61 @@ class BitstreamReader {
         memcpy(data, &m_buffer[m_currentPos], dataSize);
     }
 
-    void readPackedUint32(uint32_t &value) {
-        constexpr int n_chooseSizeBits = 2;
-        constexpr uint8_t uint8Indicator = 0b00;
-        constexpr uint8_t uint16Indicator = 0b01;
-        constexpr uint8_t uint32Indicator = 0b10;
-        uint8_t firstByte;
-        read(firstByte);
-        const uint8_t typeIndicator = firstByte >> (8 - n_chooseSizeBits);
-        const uint8_t firstByteValue = firstByte & ((1 << (8 - n_chooseSizeBits)) - 1);
-        if (typeIndicator == uint8Indicator) {
-            value = static_cast<uint32_t>(firstByteValue);
-        }
-        else if (typeIndicator == uint16Indicator) {
-            uint8_t secondByte;
-            read(secondByte);
-            value = (static_cast<uint32_t>(firstByteValue) << 8) |
-                    (static_cast<uint32_t>(secondByte));
-            // std::cout << std::bitset<32>(value) << std::endl;
-        }
-        else {
-            uint8_t secondByte;
-            uint8_t thirdByte;
-            uint8_t fourthByte;
-            read(secondByte);
-            read(thirdByte);
-            read(fourthByte);
-            value = (static_cast<uint32_t>(firstByteValue) << 24) |
-                    (static_cast<uint32_t>(secondByte) << 16) |
-                    (static_cast<uint32_t>(thirdByte) << 8) |
-                    (static_cast<uint32_t>(fourthByte));
+    // Возвращает число прочитанных байт, 0 - если данные кончились раньше (value тогда 0)
+    template<typename T>
+    uint32_t readVarUint(T &value) {
+        static_assert(std::is_unsigned_v<T>);
+        assert(m_bitsCount == 0);
+        uint64_t v = 0;
+        const uint32_t n = varint_decode(reinterpret_cast<const uint8_t*>(&m_buffer[m_currentPos]),
+                                         m_bufferSize - m_currentPos, v);
+        m_currentPos += n;
+        value = n > 0 ? static_cast<T>(v) : T(0);
+        return n;
+    }
+
+    template<typename T>
+    void readVarInt(T &value) {
+        static_assert(std::is_signed_v<T>);
+        uint64_t v;
+        readVarUint(v);
+        value = static_cast<T>(zigzag_decode(v));
+    }
+
+    // count чисел подряд одним проходом varint_decode_batch. Возвращает число прочитанных байт,
+    // 0 - если данные кончились раньше
+    size_t readVarUints(uint64_t *values, size_t count) {
+        assert(m_bitsCount == 0);
+        const size_t n = varint_decode_batch(reinterpret_cast<const uint8_t*>(&m_buffer[m_currentPos]),
+                                             m_bufferSize - m_currentPos, values, count);
+        m_currentPos += static_cast<uint32_t>(n);
+        return n;
+    }
+
+    // Чтение того, что записано BitstreamWriter::writeBits. За концом данных читаются нули и поднимается overrun()
+    void readBits(uint32_t &value, int numBits) {
+        assert(numBits > 0 && numBits <= 32);
+        while (m_bitsCount < numBits) {
+            if (m_currentPos >= m_bufferSize) {
+                m_overrun = true;
+                m_bitsCount = numBits; // старшие биты m_bits уже нулевые
+                break;
+            }
+            m_bits |= uint64_t(static_cast<uint8_t>(m_buffer[m_currentPos++])) << m_bitsCount;
+            m_bitsCount += 8;
         }
+        value = static_cast<uint32_t>(m_bits & ((uint64_t(1) << numBits) - 1));
+        m_bits >>= numBits;
+        m_bitsCount -= numBits;
+    }
+
+    // readBits дошел до конца данных: прочитанное с последней проверки не записано отправителем
+    bool overrun() const { return m_overrun; }
+
+    // Пропускает добивку до конца байта, после этого снова можно читать побайтово
+    void alignToByte() {
+        m_bits = 0;
+        m_bitsCount = 0;
     }
 
     void skip(uint32_t bytesToSkip) {
@@ -216,4 +264,7 @@ class BitstreamReader {
     char* m_buffer;
     uint32_t m_bufferSize;
     uint32_t m_currentPos;
+    uint64_t m_bits = 0;  // прочитанные из буфера, но еще не отданные readBits биты
+    int m_bitsCount = 0;
+    bool m_overrun = false;
 };
\ No newline at end of file
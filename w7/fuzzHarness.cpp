@@ -0,0 +1,39 @@
+#include "fuzzDriver.h"
+#include "protocol.h"
+#include <vector>
+
+void fuzz_deserialize(ENetPacket *packet)
+{
+  switch (get_packet_type(packet))
+  {
+  case E_CLIENT_TO_SERVER_JOIN:
+    break;
+  case E_SERVER_TO_CLIENT_NEW_ENTITY:
+    {
+      Entity ent;
+      deserialize_new_entity(packet, ent);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY:
+    {
+      uint16_t eid = invalid_entity;
+      deserialize_set_controlled_entity(packet, eid);
+    }
+    break;
+  case E_CLIENT_TO_SERVER_INPUT:
+    {
+      uint16_t eid = invalid_entity;
+      float thr = 0.f; float steer = 0.f;
+      deserialize_entity_input(packet, eid, thr, steer);
+    }
+    break;
+  case E_SERVER_TO_CLIENT_SNAPSHOT:
+    {
+      // между вызовами живет, как у клиента, чтобы замер не мерил выделение памяти
+      static std::vector<EntitySnapshot> snapshots;
+      snapshots.clear();
+      deserialize_snapshot(packet, snapshots);
+    }
+    break;
+  }
+}
@@ -9,6 +9,8 @@
 #include <vector>
 #include "entity.h"
 #include "protocol.h"
+#include "packetCapture.h"
+#include "netStats.h"
 
 
 static std::vector<Entity> entities;
@@ -17,7 +19,8 @@ static uint16_t my_entity = invalid_entity;
 void on_new_entity_packet(ENetPacket *packet)
 {
   Entity newEntity;
-  deserialize_new_entity(packet, newEntity);
+  if (!deserialize_new_entity(packet, newEntity))
+    return;
   // TODO: Direct adressing, of course!
   for (const Entity &e : entities)
     if (e.eid == newEntity.eid)
@@ -32,21 +35,27 @@ void on_set_controlled_entity(ENetPacket *packet)
 
 void on_snapshot(ENetPacket *packet)
 {
-  uint16_t eid = invalid_entity;
-  float x = 0.f; float y = 0.f; float ori = 0.f;
-  deserialize_snapshot(packet, eid, x, y, ori);
+  static std::vector<EntitySnapshot> snapshots;
+  snapshots.clear();
+  if (!deserialize_snapshot(packet, snapshots))
+    return;
   // TODO: Direct adressing, of course!
-  for (Entity &e : entities)
-    if (e.eid == eid)
-    {
-      e.x = x;
-      e.y = y;
-      e.ori = ori;
-    }
+  for (const EntitySnapshot &snapshot : snapshots)
+    for (Entity &e : entities)
+      if (e.eid == snapshot.eid)
+      {
+        e.x = snapshot.x;
+        e.y = snapshot.y;
+        e.ori = snapshot.ori;
+      }
 }
 
 int main(int argc, const char **argv)
 {
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w7_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -109,6 +118,7 @@ int main(int argc, const char **argv)
         connected = true;
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
         case E_SERVER_TO_CLIENT_NEW_ENTITY:
@@ -142,6 +152,8 @@ int main(int argc, const char **argv)
 
           // Send
           send_entity_input(serverPeer, my_entity, thr, steer);
+          // мир не ограничен рамкой, камера следует за своей сущностью
+          camera.target = Vector2{ e.x, e.y };
         }
     }
 
@@ -1,83 +1,251 @@
 #include "protocol.h"
 #include "quantisation.h"
+#include "quantisationBatch.h"
+#include <cmath>
 #include <cstring> // memcpy
 #include <iostream>
 #include "bitstream.h"
+#include "rans.h"
+#include "snapshotModel.h"
+#include <cstdio>
+#include "netStats.h"
+#include "netSend.h"
 
 void send_join(ENetPeer *peer)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_JOIN);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t), ENET_PACKET_FLAG_RELIABLE);
   *packet->data = E_CLIENT_TO_SERVER_JOIN;
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_new_entity(ENetPeer *peer, const Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_NEW_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(Entity),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_NEW_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &ent, sizeof(Entity)); ptr += sizeof(Entity);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t),
                                                    ENET_PACKET_FLAG_RELIABLE);
   uint8_t *ptr = packet->data;
   *ptr = E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY; ptr += sizeof(uint8_t);
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
 
-  enet_peer_send(peer, 0, packet);
+  net_send_packet(peer, 0, packet);
 }
 
 void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float ori)
 {
+  NetStatsTimer timer(E_NET_STATS_SENT, E_CLIENT_TO_SERVER_INPUT);
   ENetPacket *packet = enet_packet_create(nullptr, sizeof(uint8_t) + sizeof(uint16_t) +
                                                    sizeof(uint8_t),
                                                    ENET_PACKET_FLAG_UNSEQUENCED);
   uint8_t *ptr = packet->data;
   *ptr = E_CLIENT_TO_SERVER_INPUT; ptr += sizeof(uint8_t);
   memcpy(ptr, &eid, sizeof(uint16_t)); ptr += sizeof(uint16_t);
-  float4bitsQuantized thrPacked(thr, -1.f, 1.f);
-  float4bitsQuantized oriPacked(ori, -1.f, 1.f);
-  uint8_t thrSteerPacked = (thrPacked.packedVal << 4) | oriPacked.packedVal;
+  uint8_t thrSteerPacked = (ControlQuantized::pack(thr) << 4) | ControlQuantized::pack(ori);
   memcpy(ptr, &thrSteerPacked, sizeof(uint8_t)); ptr += sizeof(uint8_t);
   /*
   memcpy(ptr, &thrPacked, sizeof(uint8_t)); ptr += sizeof(uint8_t);
   memcpy(ptr, &oriPacked, sizeof(uint8_t)); ptr += sizeof(uint8_t);
   */
 
-  enet_peer_send(peer, 1, packet);
+  net_send_packet(peer, 1, packet);
 }
 
-typedef PackedFloat<uint16_t, 11> PositionXQuantized;
-typedef PackedFloat<uint16_t, 10> PositionYQuantized;
+static constexpr int SNAPSHOT_PRECISION_BITS[E_PRECISION_COUNT] = {
+  TransformQuantized::NUM_BITS,
+  TransformQuantizedHigh::NUM_BITS,
+  TransformQuantizedMedium::NUM_BITS,
+  TransformQuantizedLow::NUM_BITS
+};
 
-void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y, float ori)
+void SnapshotTransforms::resize(size_t count)
 {
-  BitstreamWriter bs;
-  bs.write(E_SERVER_TO_CLIENT_SNAPSHOT, eid);
-  
+  eids.resize(count);
+  x.resize(count);
+  y.resize(count);
+  ori.resize(count);
+  cellX.resize(count);
+  cellY.resize(count);
+  offsetX.resize(count);
+  offsetY.resize(count);
+  for (std::vector<uint32_t> &words : packed)
+    words.resize(count);
+}
+
+int16_t snapshot_cell(float v)
+{
+  float cell = floorf(v * (1.f / SNAPSHOT_CELL_SIZE));
+  // сравнения в таком виде превращают NaN в INT16_MIN, а не в неопределенное преобразование
+  cell = cell > float(INT16_MIN) ? cell : float(INT16_MIN);
+  cell = cell < float(INT16_MAX) ? cell : float(INT16_MAX);
+  return static_cast<int16_t>(cell);
+}
+
+void SnapshotTransforms::pack()
+{
+  const size_t count = size();
+  for (size_t i = 0; i < count; ++i)
+  {
+    cellX[i] = snapshot_cell(x[i]);
+    cellY[i] = snapshot_cell(y[i]);
+    offsetX[i] = x[i] - float(cellX[i]) * SNAPSHOT_CELL_SIZE;
+    offsetY[i] = y[i] - float(cellY[i]) * SNAPSHOT_CELL_SIZE;
+  }
+  const float *ox = offsetX.data();
+  const float *oy = offsetY.data();
+  pack_vec3_batch<TransformQuantized>(ox, oy, ori.data(), packed[E_PRECISION_FULL].data(), count);
+  pack_vec3_batch<TransformQuantizedHigh>(ox, oy, ori.data(), packed[E_PRECISION_HIGH].data(), count);
+  pack_vec3_batch<TransformQuantizedMedium>(ox, oy, ori.data(), packed[E_PRECISION_MEDIUM].data(), count);
+  pack_vec3_batch<TransformQuantizedLow>(ox, oy, ori.data(), packed[E_PRECISION_LOW].data(), count);
+}
+
+void choose_snapshot_precision(const SnapshotTransforms &transforms, float viewerX, float viewerY,
+                               SnapshotPrecision *precisions)
+{
+  constexpr float d0 = SNAPSHOT_PRECISION_DISTANCE[0] * SNAPSHOT_PRECISION_DISTANCE[0];
+  constexpr float d1 = SNAPSHOT_PRECISION_DISTANCE[1] * SNAPSHOT_PRECISION_DISTANCE[1];
+  constexpr float d2 = SNAPSHOT_PRECISION_DISTANCE[2] * SNAPSHOT_PRECISION_DISTANCE[2];
+  const float *x = transforms.x.data();
+  const float *y = transforms.y.data();
+  for (size_t i = 0, n = transforms.size(); i < n; ++i)
+  {
+    const float dx = x[i] - viewerX;
+    const float dy = y[i] - viewerY;
+    const float dist2 = dx * dx + dy * dy;
+    // порог за порогом без ветвлений, цикл векторизуется
+    precisions[i] = SnapshotPrecision(int(dist2 > d0) + int(dist2 > d1) + int(dist2 > d2));
+  }
+}
+
+static uint32_t cell_code(int16_t cell, int16_t anchorCell)
+{
+  const int32_t delta = int32_t(cell) - int32_t(anchorCell);
+  return delta >= -1 && delta <= 1 ? uint32_t(delta + 1) : SNAPSHOT_CELL_ESCAPE;
+}
+
+static void write_cell(BitstreamWriter &bs, int16_t cell, int16_t anchorCell)
+{
+  const uint32_t code = cell_code(cell, anchorCell);
+  bs.writeBits(code, SNAPSHOT_CELL_CODE_BITS);
+  if (code == SNAPSHOT_CELL_ESCAPE)
+    bs.writeBits(static_cast<uint16_t>(cell), SNAPSHOT_CELL_BITS);
+}
+
+static uint32_t cell_bits(int16_t cell, int16_t anchorCell)
+{
+  return SNAPSHOT_CELL_CODE_BITS + (cell_code(cell, anchorCell) == SNAPSHOT_CELL_ESCAPE ? SNAPSHOT_CELL_BITS : 0);
+}
+
+static FILE *snapshotCapture = nullptr;
+
+bool record_snapshot_payloads(const char *path)
+{
+  if (snapshotCapture)
+    fclose(snapshotCapture);
+  snapshotCapture = fopen(path, "wb");
+  return snapshotCapture != nullptr;
+}
+
+static const RansModel &snapshot_model()
+{
+  static const RansModel model = []()
+  {
+    RansModel m;
+    rans_init_model(m, SNAPSHOT_BYTE_FREQUENCIES);
+    return m;
+  }();
+  return model;
+}
+
+// Тип, кодек и полезный груз: сжатый rANS с размером исходного впереди или как есть, если сжатие не выиграло
+static void send_snapshot_payload(ENetPeer *peer, const uint8_t *payload, uint32_t size)
+{
+  if (snapshotCapture)
+  {
+    fwrite(&size, sizeof(size), 1, snapshotCapture);
+    fwrite(payload, 1, size, snapshotCapture);
+    // сервер останавливают сигналом, без сброса хвост записи потерялся бы
+    fflush(snapshotCapture);
+  }
+
+  static thread_local std::vector<uint8_t> coded;
+  constexpr size_t headerSize = sizeof(MessageType) + sizeof(SnapshotCodec);
+  coded.resize(headerSize + VARINT_MAX_SIZE + rans_encode_bound(size));
+  coded[0] = E_SERVER_TO_CLIENT_SNAPSHOT;
+  coded[1] = E_SNAPSHOT_CODEC_RANS;
+  const size_t sizeBytes = varint_encode(size, &coded[headerSize]);
+  const size_t encoded = rans_encode(snapshot_model(), payload, size, &coded[headerSize + sizeBytes],
+                                     coded.size() - headerSize - sizeBytes);
+  if (encoded > 0 && sizeBytes + encoded < size)
   {
-    PackedVec3<uint32_t, 11, 10, 8> xYoriPacked(x, {-16, 16}, y, {-8, 8}, ori, {-PI, PI});
-    bs.write(xYoriPacked.packedVal);
+    net_send_packet(peer, 1, enet_packet_create(coded.data(), headerSize + sizeBytes + encoded,
+                                            ENET_PACKET_FLAG_UNSEQUENCED));
+    return;
   }
+  ENetPacket *packet = enet_packet_create(nullptr, headerSize + size, ENET_PACKET_FLAG_UNSEQUENCED);
+  packet->data[0] = E_SERVER_TO_CLIENT_SNAPSHOT;
+  packet->data[1] = E_SNAPSHOT_CODEC_RAW;
+  memcpy(packet->data + headerSize, payload, size);
+  net_send_packet(peer, 1, packet);
+}
 
-  // {
-  //   PositionXQuantized xPacked(x, -16, 16);
-  //   PositionYQuantized yPacked(y, -8, 8);
-  //   uint8_t oriPacked = pack_float<uint8_t>(ori, -PI, PI, 8);
-  //   bs.writePackedUint32(xPacked.packedVal);
-  //   bs.writePackedUint32(yPacked.packedVal);
-  //   bs.write(oriPacked);
-  // }
+// Пакет: тип, кодек, затем полезный груз (возможно, сжатый): число сущностей и разности eid соседних сущностей (varint, zigzag; у первой - от нуля),
+// затем побитово без выравнивания ячейка-якорь и по сущности тег точности, коды ячеек по x и y
+// (с полной координатой после SNAPSHOT_CELL_ESCAPE) и слово TransformQuantized* этой точности.
+// Сервер перечисляет сущности по возрастанию eid, поэтому разность почти всегда 1 и занимает байт
+void send_snapshot(ENetPeer *peer, const SnapshotTransforms &transforms, const SnapshotPrecision *precisions,
+                   int16_t anchorCellX, int16_t anchorCellY)
+{
+  NetStatsTimer timer(E_NET_STATS_SENT, E_SERVER_TO_CLIENT_SNAPSHOT);
+  constexpr uint32_t maxBits = (SNAPSHOT_MAX_PACKET_SIZE - sizeof(MessageType) - sizeof(SnapshotCodec) -
+                                sizeof(uint32_t)) * 8 - 2 * SNAPSHOT_CELL_BITS;
+  const size_t count = transforms.size();
+  size_t begin = 0;
+  while (begin < count)
+  {
+    size_t end = begin;
+    for (uint32_t bits = 0, prevEid = 0; end < count; ++end)
+    {
+      const int64_t eidDelta = int64_t(transforms.eids[end]) - int64_t(prevEid);
+      bits += varint_size(zigzag_encode(eidDelta)) * 8 + SNAPSHOT_PRECISION_TAG_BITS +
+              SNAPSHOT_PRECISION_BITS[precisions[end]] +
+              cell_bits(transforms.cellX[end], anchorCellX) + cell_bits(transforms.cellY[end], anchorCellY);
+      if (bits > maxBits)
+        break;
+      prevEid = transforms.eids[end];
+    }
 
-  ENetPacket *packet = enet_packet_create(bs.data(), bs.size(), ENET_PACKET_FLAG_UNSEQUENCED);
-  enet_peer_send(peer, 1, packet);
+    BitstreamWriter bs;
+    bs.writeVarUint(end - begin);
+    for (size_t i = begin, prevEid = 0; i < end; prevEid = transforms.eids[i++])
+      bs.writeVarInt(int64_t(transforms.eids[i]) - int64_t(prevEid));
+    bs.writeBits(static_cast<uint16_t>(anchorCellX), SNAPSHOT_CELL_BITS);
+    bs.writeBits(static_cast<uint16_t>(anchorCellY), SNAPSHOT_CELL_BITS);
+    for (size_t i = begin; i < end; ++i)
+    {
+      const SnapshotPrecision precision = precisions[i];
+      bs.writeBits(precision, SNAPSHOT_PRECISION_TAG_BITS);
+      write_cell(bs, transforms.cellX[i], anchorCellX);
+      write_cell(bs, transforms.cellY[i], anchorCellY);
+      bs.writeBits(transforms.packed[precision][i], SNAPSHOT_PRECISION_BITS[precision]);
+    }
+    bs.alignToByte();
+
+    send_snapshot_payload(peer, reinterpret_cast<const uint8_t*>(bs.data()), bs.size());
+    begin = end;
+  }
 }
 
 MessageType get_packet_type(ENetPacket *packet)
@@ -85,20 +253,44 @@ MessageType get_packet_type(ENetPacket *packet)
   return (MessageType)*packet->data;
 }
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent)
+const char *message_type_name(uint8_t type)
+{
+  switch (type)
+  {
+  case E_CLIENT_TO_SERVER_JOIN: return "join";
+  case E_SERVER_TO_CLIENT_NEW_ENTITY: return "new_entity";
+  case E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY: return "set_controlled_entity";
+  case E_CLIENT_TO_SERVER_INPUT: return "input";
+  case E_SERVER_TO_CLIENT_SNAPSHOT: return "snapshot";
+  }
+  return nullptr;
+}
+
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_NEW_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(Entity))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   ent = *(Entity*)(ptr); ptr += sizeof(Entity);
+  return true;
 }
 
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SET_CONTROLLED_ENTITY);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint16_t))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
+  return true;
 }
 
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer)
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer)
 {
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_CLIENT_TO_SERVER_INPUT);
+  if (packet->dataLength < sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint8_t))
+    return false;
   uint8_t *ptr = packet->data; ptr += sizeof(uint8_t);
   eid = *(uint16_t*)(ptr); ptr += sizeof(uint16_t);
   uint8_t thrSteerPacked = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
@@ -106,46 +298,101 @@ void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, flo
   uint8_t thrPacked = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
   uint8_t oriPacked = *(uint8_t*)(ptr); ptr += sizeof(uint8_t);
   */
-  static uint8_t neutralPackedValue = pack_float<uint8_t>(0.f, -1.f, 1.f, 4);
-  static uint8_t nominalPackedValue = pack_float<uint8_t>(1.f, 0.f, 1.2f, 4);
-  float4bitsQuantized thrPacked(thrSteerPacked >> 4);
-  float4bitsQuantized steerPacked(thrSteerPacked & 0x0f);
-  thr = thrPacked.packedVal == neutralPackedValue ? 0.f : thrPacked.unpack(-1.f, 1.f);
-  steer = steerPacked.packedVal == neutralPackedValue ? 0.f : steerPacked.unpack(-1.f, 1.f);
+  constexpr uint8_t neutralPackedValue = ControlQuantized::pack(0.f);
+  const uint8_t thrPacked = thrSteerPacked >> 4;
+  const uint8_t steerPacked = thrSteerPacked & 0x0f;
+  thr = thrPacked == neutralPackedValue ? 0.f : ControlQuantized::unpack(thrPacked);
+  steer = steerPacked == neutralPackedValue ? 0.f : ControlQuantized::unpack(steerPacked);
+  return true;
 }
 
 template<typename T>
 using Skip = BitstreamReader::Skip<T>;
 
 
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori)
+template<typename Transform>
+static void read_transform(BitstreamReader &bs, EntitySnapshot &snapshot)
 {
-  BitstreamReader bs(reinterpret_cast<char*>(packet->data), packet->dataLength);
-  bs.read(Skip<MessageType>(), eid);
+  uint32_t packed;
+  bs.readBits(packed, Transform::NUM_BITS);
+  Transform::unpack(packed, snapshot.x, snapshot.y, snapshot.ori);
+}
 
-  {
-    uint32_t xYoriPacked;
-    bs.read(xYoriPacked);
+static int16_t read_cell(BitstreamReader &bs, int16_t anchorCell)
+{
+  uint32_t code;
+  bs.readBits(code, SNAPSHOT_CELL_CODE_BITS);
+  if (code != SNAPSHOT_CELL_ESCAPE)
+    return static_cast<int16_t>(anchorCell + int32_t(code) - 1);
+  uint32_t cell;
+  bs.readBits(cell, SNAPSHOT_CELL_BITS);
+  return static_cast<int16_t>(cell);
+}
 
-    PackedVec3<uint32_t, 11, 10, 8> xYoriPackedVal(xYoriPacked);
-    auto [xVal, yVal, oriVal] = xYoriPackedVal.unpack({-16, 16}, {-8, 8}, {-PI, PI});
-    x = xVal; y = yVal; ori = oriVal;
+bool deserialize_snapshot(ENetPacket *packet, std::vector<EntitySnapshot> &snapshots)
+{
+  NetStatsTimer timer(E_NET_STATS_RECEIVED, E_SERVER_TO_CLIENT_SNAPSHOT);
+  constexpr size_t headerSize = sizeof(MessageType) + sizeof(SnapshotCodec);
+  if (packet->dataLength < headerSize)
+    return false;
+  char *payload = reinterpret_cast<char*>(packet->data + headerSize);
+  uint32_t payloadSize = static_cast<uint32_t>(packet->dataLength - headerSize);
+  // сервер не собирает пакеты больше SNAPSHOT_MAX_PACKET_SIZE, больший размер - мусор при любом кодеке
+  if (payloadSize > SNAPSHOT_MAX_PACKET_SIZE)
+    return false;
+  if (packet->data[1] == E_SNAPSHOT_CODEC_RANS)
+  {
+    static thread_local std::vector<uint8_t> decoded;
+    uint64_t size;
+    const uint32_t sizeBytes = varint_decode(packet->data + headerSize, payloadSize, size);
+    // и распакованный полезный груз не больше пакета: rANS отправляется, только если выиграл
+    if (sizeBytes == 0 || size > SNAPSHOT_MAX_PACKET_SIZE)
+      return false;
+    decoded.resize(size);
+    if (!rans_decode(snapshot_model(), packet->data + headerSize + sizeBytes, payloadSize - sizeBytes,
+                     decoded.data(), size))
+      return false;
+    payload = reinterpret_cast<char*>(decoded.data());
+    payloadSize = static_cast<uint32_t>(size);
   }
 
-  // {
-  //   uint32_t xPacked, yPacked;
-  //   bs.readPackedUint32(xPacked);
-  //   bs.readPackedUint32(yPacked);
-  //   PositionXQuantized xPackedVal(xPacked);
-  //   PositionYQuantized yPackedVal(yPacked);
-
-  //   uint8_t oriPacked;
-  //   bs.read(oriPacked);
+  BitstreamReader bs(payload, payloadSize);
+  uint32_t count;
+  // каждая сущность занимает хотя бы байт, поэтому большее число - мусор, и под него нельзя выделять память
+  if (bs.readVarUint(count) == 0 || count > payloadSize)
+    return false;
+  static thread_local std::vector<uint64_t> eidDeltas;
+  eidDeltas.resize(count);
+  if (count > 0 && bs.readVarUints(eidDeltas.data(), count) == 0)
+    return false;
+  uint32_t anchorCellX, anchorCellY;
+  bs.readBits(anchorCellX, SNAPSHOT_CELL_BITS);
+  bs.readBits(anchorCellY, SNAPSHOT_CELL_BITS);
 
-  //   x = xPackedVal.unpack(-16, 16);
-  //   y = yPackedVal.unpack(-8, 8);
-  //   ori = unpack_float<uint8_t>(oriPacked, -PI, PI, 8);
-  // }
-  // std::cout << packet->dataLength << std::endl;
+  uint16_t eid = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    eid = static_cast<uint16_t>(eid + zigzag_decode(eidDeltas[i]));
+    uint32_t precision;
+    bs.readBits(precision, SNAPSHOT_PRECISION_TAG_BITS);
+    const int16_t cellX = read_cell(bs, static_cast<int16_t>(anchorCellX));
+    const int16_t cellY = read_cell(bs, static_cast<int16_t>(anchorCellY));
+    EntitySnapshot snapshot;
+    snapshot.eid = eid;
+    switch (precision)
+    {
+      case E_PRECISION_FULL:   read_transform<TransformQuantized>(bs, snapshot); break;
+      case E_PRECISION_HIGH:   read_transform<TransformQuantizedHigh>(bs, snapshot); break;
+      case E_PRECISION_MEDIUM: read_transform<TransformQuantizedMedium>(bs, snapshot); break;
+      default:                 read_transform<TransformQuantizedLow>(bs, snapshot); break;
+    }
+    // в snapshot.x, snapshot.y пока смещения внутри ячейки
+    snapshot.x += float(cellX) * SNAPSHOT_CELL_SIZE;
+    snapshot.y += float(cellY) * SNAPSHOT_CELL_SIZE;
+    // пакет обрезан: эта сущность и все следующие дочитаны нулями
+    if (bs.overrun())
+      return false;
+    snapshots.push_back(snapshot);
+  }
+  return true;
 }
-
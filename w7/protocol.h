@@ -1,7 +1,11 @@
 #pragma once
 #include <enet/enet.h>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 #include "entity.h"
+#include "quantisation.h"
 
 enum MessageType : uint8_t
 {
@@ -12,16 +16,114 @@ enum MessageType : uint8_t
   E_SERVER_TO_CLIENT_SNAPSHOT
 };
 
+// Квантованные поля протокола: диапазоны и разрядности заданы здесь один раз для отправки и приема
+typedef QuantizedFloat<uint8_t, -1.f, 1.f, 4> ControlQuantized;
+
+// Мир не ограничен: положение - это ячейка сетки SNAPSHOT_CELL_SIZE x SNAPSHOT_CELL_SIZE с 16-битными координатами
+// и квантованное смещение внутри нее. Ячейки в пакете пишутся относительно якоря (ячейки получателя):
+// соседняя по оси - 2 битами, дальняя - кодом SNAPSHOT_CELL_ESCAPE и полной координатой ячейки.
+// Точность смещения от расстояния до начала координат не зависит
+constexpr float SNAPSHOT_CELL_SIZE = 16.f;
+constexpr int SNAPSHOT_CELL_BITS = 16;
+constexpr int SNAPSHOT_CELL_CODE_BITS = 2;
+constexpr uint32_t SNAPSHOT_CELL_ESCAPE = 3; // коды 0, 1, 2 - ячейка якоря -1, 0, +1
+
+template<int NumBits>
+using CellOffsetQuantizedBits = QuantizedFloat<uint16_t, 0.f, SNAPSHOT_CELL_SIZE, NumBits, E_ROUND_NEAREST>;
+// [-PI, PI]; числом, а не PI из mathUtils.h, потому что raylib.h у клиента объявляет PI макросом
+template<int NumBits>
+using OrientationQuantizedBits = QuantizedFloat<uint8_t, -3.141592654f, 3.141592654f, NumBits, E_ROUND_NEAREST>;
+template<int OffsetBits, int OriBits>
+using TransformQuantizedBits = QuantizedVec3<uint32_t, CellOffsetQuantizedBits<OffsetBits>,
+                                                       CellOffsetQuantizedBits<OffsetBits>,
+                                                       OrientationQuantizedBits<OriBits>>;
+
+// Точность положения сущности в снепшоте зависит от расстояния до сущности, которой управляет получатель:
+// далекие сущности занимают большую часть мира, а их ошибку на экране почти не видно.
+// Точность передается 2-битным тегом перед полями сущности
+enum SnapshotPrecision : uint8_t
+{
+  E_PRECISION_FULL = 0,
+  E_PRECISION_HIGH,
+  E_PRECISION_MEDIUM,
+  E_PRECISION_LOW,
+  E_PRECISION_COUNT
+};
+
+constexpr int SNAPSHOT_PRECISION_TAG_BITS = 2;
+static_assert(E_PRECISION_COUNT <= (1 << SNAPSHOT_PRECISION_TAG_BITS));
+
+// шаг смещения 1/64, 1/16, 1/4 и 1 единица
+typedef TransformQuantizedBits<10, 8> TransformQuantized;
+typedef TransformQuantizedBits<8, 7> TransformQuantizedHigh;
+typedef TransformQuantizedBits<6, 6> TransformQuantizedMedium;
+typedef TransformQuantizedBits<4, 5> TransformQuantizedLow;
+
+// Дальше SNAPSHOT_PRECISION_DISTANCE[p] от получателя сущность передается с точностью хуже p
+constexpr float SNAPSHOT_PRECISION_DISTANCE[E_PRECISION_COUNT - 1] = {4.f, 8.f, 16.f};
+// Снепшоты сущностей собираются в пакеты не больше этого размера, чтобы ENet не фрагментировал их
+constexpr uint32_t SNAPSHOT_MAX_PACKET_SIZE = 1024;
+
+// Положения всех сущностей тика, квантованные разом во всех точностях. Считаются один раз за тик,
+// каждому пиру уходит своя выборка точностей
+struct SnapshotTransforms
+{
+  std::vector<uint16_t> eids;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> ori;
+  std::vector<int16_t> cellX;
+  std::vector<int16_t> cellY;
+  std::vector<float> offsetX;
+  std::vector<float> offsetY;
+  std::array<std::vector<uint32_t>, E_PRECISION_COUNT> packed;
+
+  size_t size() const { return eids.size(); }
+  void resize(size_t count);
+  // раскладывает x, y на ячейки и смещения и квантует смещения и ori в packed
+  void pack();
+};
+
+// Ячейка, в которую попадает координата; за пределами 16-битных координат - крайняя
+int16_t snapshot_cell(float v);
+
+// Полезный груз снепшота после заголовка либо как есть, либо сжат rANS со статической моделью (snapshotModel.h)
+enum SnapshotCodec : uint8_t
+{
+  E_SNAPSHOT_CODEC_RAW = 0,
+  E_SNAPSHOT_CODEC_RANS
+};
+
+struct EntitySnapshot
+{
+  uint16_t eid = invalid_entity;
+  float x = 0.f;
+  float y = 0.f;
+  float ori = 0.f;
+};
+
 void send_join(ENetPeer *peer);
 void send_new_entity(ENetPeer *peer, const Entity &ent);
 void send_set_controlled_entity(ENetPeer *peer, uint16_t eid);
 void send_entity_input(ENetPeer *peer, uint16_t eid, float thr, float steer);
-void send_snapshot(ENetPeer *peer, uint16_t eid, float x, float y, float ori);
+// Точность для каждой сущности, если получатель управляет сущностью в (viewerX, viewerY)
+void choose_snapshot_precision(const SnapshotTransforms &transforms, float viewerX, float viewerY,
+                               SnapshotPrecision *precisions);
+// anchorCellX, anchorCellY - якорь пакетов, выгоднее всего ячейка получателя
+void send_snapshot(ENetPeer *peer, const SnapshotTransforms &transforms, const SnapshotPrecision *precisions,
+                   int16_t anchorCellX, int16_t anchorCellY);
+// Дописывает в файл полезный груз каждого снепшота до сжатия (uint32 размер, затем байты) -
+// запись для обучения модели: w7_snapshot_model train <файл> snapshotModel.h
+bool record_snapshot_payloads(const char *path);
 
 MessageType get_packet_type(ENetPacket *packet);
+// Имя типа для счетчиков трафика, записи корпуса и fuzz-драйвера (common/), nullptr для неизвестного типа
+const char *message_type_name(uint8_t type);
 
-void deserialize_new_entity(ENetPacket *packet, Entity &ent);
-void deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
-void deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer);
-void deserialize_snapshot(ENetPacket *packet, uint16_t &eid, float &x, float &y, float &ori);
+// false - пакет короче сообщения своего типа или с неверными данными, его пропускают
+bool deserialize_new_entity(ENetPacket *packet, Entity &ent);
+bool deserialize_set_controlled_entity(ENetPacket *packet, uint16_t &eid);
+bool deserialize_entity_input(ENetPacket *packet, uint16_t &eid, float &thr, float &steer);
+// Дописывает в snapshots все сущности пакета
+bool deserialize_snapshot(ENetPacket *packet, std::vector<EntitySnapshot> &snapshots);
 
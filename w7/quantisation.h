@@ -1,20 +1,68 @@
 #pragma once
-#include "mathUtils.h"
+#include <cassert>
+#include <cstdint>
 #include <limits>
 #include <tuple>
+#include <type_traits>
+
+enum QuantizationRounding : uint8_t
+{
+  E_ROUND_TRUNCATE = 0, // код - ближайший снизу шаг
+  E_ROUND_NEAREST       // код - ближайший шаг, ошибка вдвое меньше при той же разрядности
+};
+
+// Диапазон [lo, hi], разбитый на 2^numBits - 1 шагов. Масштаб и шаг считаются один раз при создании,
+// поэтому квантование - это вычитание и умножение без деления. Этими же формулами пользуются пакетные ядра
+// из quantisationBatch.h, и их результат бит в бит совпадает с поэлементным
+struct Quantizer
+{
+  float lo;
+  float hi;
+  int numBits;
+  float scale; // (2^numBits - 1) / (hi - lo)
+  float step;  // (hi - lo) / (2^numBits - 1)
+  float bias;  // прибавляется перед отбрасыванием дробной части: 0 или 0.5
+
+  constexpr Quantizer(float lo, float hi, int num_bits, QuantizationRounding rounding = E_ROUND_TRUNCATE)
+    : lo(lo), hi(hi), numBits(num_bits),
+      scale(float((1u << num_bits) - 1) / (hi - lo)),
+      step((hi - lo) / float((1u << num_bits) - 1)),
+      bias(rounding == E_ROUND_NEAREST ? 0.5f : 0.f)
+  {
+    // scaled + bias должно отличать половинки шага: с 2^23 у float шаг уже 1, и +0.5 округляет нечетные коды вверх,
+    // а старший код переполняет поле. 22 бита оставляют запас в один разряд
+    assert(num_bits > 0 && num_bits <= 22);
+  }
+
+  constexpr uint32_t mask() const { return (1u << numBits) - 1; }
+
+  // Сравнения записаны так же, как работают maxps/minps: NaN превращается в lo.
+  // Умножение и сложение разными выражениями, чтобы компилятор не слил их в FMA, которого нет в SIMD ядрах
+  constexpr uint32_t quantize(float v) const
+  {
+    v = v > lo ? v : lo;
+    v = v < hi ? v : hi;
+    const float scaled = (v - lo) * scale;
+    return static_cast<uint32_t>(static_cast<int32_t>(scaled + bias));
+  }
+
+  constexpr float dequantize(uint32_t c) const
+  {
+    const float scaled = static_cast<float>(static_cast<int32_t>(c)) * step;
+    return scaled + lo;
+  }
+};
 
 template<typename T>
 T pack_float(float v, float lo, float hi, int num_bits)
 {
-  T range = (1 << num_bits) - 1;//std::numeric_limits<T>::max();
-  return range * ((clamp(v, lo, hi) - lo) / (hi - lo));
+  return static_cast<T>(Quantizer(lo, hi, num_bits).quantize(v));
 }
 
 template<typename T>
 float unpack_float(T c, float lo, float hi, int num_bits)
 {
-  T range = (1 << num_bits) - 1;//std::numeric_limits<T>::max();
-  return float(c) / range * (hi - lo) + lo;
+  return Quantizer(lo, hi, num_bits).dequantize(c);
 }
 
 template<typename T, int num_bits>
@@ -31,54 +79,51 @@ struct PackedFloat
 
 typedef PackedFloat<uint8_t, 4> float4bitsQuantized;
 
-struct ValuesRange {
-  float lo;
-  float hi;
-};
-
-template<typename T, int num_bits1, int num_bits2>
-struct PackedVec2
+// Поле, у которого диапазон, разрядность и округление - параметры типа. Масштаб считает компилятор,
+// а клиент и сервер, упаковывающие одно и то же поле одним типом, не могут разойтись в диапазонах
+template<typename T, float Lo, float Hi, int NumBits, QuantizationRounding Rounding = E_ROUND_TRUNCATE>
+struct QuantizedFloat
 {
-  T packedVal;
+  static_assert(std::is_unsigned_v<T>, "Storage type must be unsigned");
+  static_assert(NumBits > 0 && NumBits <= 22, "NumBits must be in [1, 22] so that scaled + 0.5 stays exact in float");
+  static_assert(NumBits <= int(sizeof(T) * 8), "NumBits does not fit into storage type");
+  static_assert(Lo < Hi, "Empty quantization range");
 
-  PackedVec2(float v1, const ValuesRange& r1, 
-              float v2, const ValuesRange& r2) { pack(v1, r1, v2, r2); }
-  PackedVec2(T compressed_val) : packedVal(compressed_val) {}
+  typedef T Storage;
+  static constexpr int NUM_BITS = NumBits;
+  static constexpr Quantizer QUANTIZER{Lo, Hi, NumBits, Rounding};
 
-  void pack(float v1, const ValuesRange& r1, 
-            float v2, const ValuesRange& r2) 
-  { 
-    packedVal = (pack_float<T>(v2, r2.lo, r2.hi, num_bits2) << num_bits1) | pack_float<T>(v1, r1.lo, r1.hi, num_bits1); 
-  }
-  auto unpack(const ValuesRange& r1, const ValuesRange& r2) 
-  { 
-    return std::make_tuple(unpack_float<T>(packedVal & ((1 << num_bits1) - 1), r1.lo, r1.hi, num_bits1),
-                           unpack_float<T>(packedVal >> num_bits1, r2.lo, r2.hi, num_bits2)); 
-  }
+  static constexpr T pack(float v) { return static_cast<T>(QUANTIZER.quantize(v)); }
+  static constexpr float unpack(T c) { return QUANTIZER.dequantize(c); }
 };
 
-template<typename T, int num_bits1, int num_bits2, int num_bits3>
-struct PackedVec3
+// Три поля типа QuantizedFloat в одном слове: F1 в младших битах, затем F2 и F3
+template<typename T, typename F1, typename F2, typename F3>
+struct QuantizedVec3
 {
-  T packedVal;
+  static_assert(std::is_unsigned_v<T>, "Storage type must be unsigned");
+  static_assert(F1::NUM_BITS + F2::NUM_BITS + F3::NUM_BITS <= int(sizeof(T) * 8),
+                "Fields do not fit into storage type");
+
+  typedef T Storage;
+  typedef F1 Field1;
+  typedef F2 Field2;
+  typedef F3 Field3;
+  static constexpr int NUM_BITS = F1::NUM_BITS + F2::NUM_BITS + F3::NUM_BITS;
+  static constexpr int SHIFT2 = F1::NUM_BITS;
+  static constexpr int SHIFT3 = F1::NUM_BITS + F2::NUM_BITS;
 
-  PackedVec3(float v1, const ValuesRange& r1, 
-             float v2, const ValuesRange& r2,
-             float v3, const ValuesRange& r3) { pack(v1, r1, v2, r2, v3, r3); }
-  PackedVec3(T compressed_val) : packedVal(compressed_val) {}
-
-  void pack(float v1, const ValuesRange& r1, 
-            float v2, const ValuesRange& r2,
-            float v3, const ValuesRange& r3) 
-  { 
-    packedVal = (pack_float<T>(v3, r3.lo, r3.hi, num_bits3) << (num_bits1 + num_bits2)) |
-                (pack_float<T>(v2, r2.lo, r2.hi, num_bits2) << num_bits1) | 
-                 pack_float<T>(v1, r1.lo, r1.hi, num_bits1); 
+  static constexpr T pack(float v1, float v2, float v3)
+  {
+    return static_cast<T>(F1::QUANTIZER.quantize(v1) |
+                          (static_cast<T>(F2::QUANTIZER.quantize(v2)) << SHIFT2) |
+                          (static_cast<T>(F3::QUANTIZER.quantize(v3)) << SHIFT3));
   }
-  auto unpack(const ValuesRange& r1, const ValuesRange& r2, const ValuesRange& r3) 
-  { 
-    return std::make_tuple(unpack_float<T>(packedVal & ((1 << num_bits1) - 1), r1.lo, r1.hi, num_bits1),
-                           unpack_float<T>((packedVal >> num_bits1) & ((1 << num_bits2) - 1), r2.lo, r2.hi, num_bits2),
-                           unpack_float<T>(packedVal >> (num_bits1 + num_bits2), r3.lo, r3.hi, num_bits3)); 
+
+  static constexpr void unpack(T packed, float &v1, float &v2, float &v3)
+  {
+    v1 = F1::QUANTIZER.dequantize(static_cast<uint32_t>(packed & F1::QUANTIZER.mask()));
+    v2 = F2::QUANTIZER.dequantize(static_cast<uint32_t>((packed >> SHIFT2) & F2::QUANTIZER.mask()));
+    v3 = F3::QUANTIZER.dequantize(static_cast<uint32_t>((packed >> SHIFT3) & F3::QUANTIZER.mask()));
   }
 };
@@ -0,0 +1,185 @@
+#include "quantisationBatch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define QUANTISATION_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUANTISATION_SSE2 1
+#endif
+
+namespace
+{
+
+// max/min в таком порядке аргументов ведут себя как сравнения в Quantizer::quantize, включая NaN
+
+#ifdef QUANTISATION_AVX2
+struct Lanes8
+{
+  __m256 lo, hi, scale, step, bias;
+  explicit Lanes8(const Quantizer &q)
+    : lo(_mm256_set1_ps(q.lo)), hi(_mm256_set1_ps(q.hi)),
+      scale(_mm256_set1_ps(q.scale)), step(_mm256_set1_ps(q.step)), bias(_mm256_set1_ps(q.bias)) {}
+
+  __m256i quantize(__m256 v) const
+  {
+    v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(v, lo), scale), bias));
+  }
+
+  __m256 dequantize(__m256i c) const
+  {
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c), step), lo);
+  }
+};
+#endif
+
+#ifdef QUANTISATION_SSE2
+struct Lanes4
+{
+  __m128 lo, hi, scale, step, bias;
+  explicit Lanes4(const Quantizer &q)
+    : lo(_mm_set1_ps(q.lo)), hi(_mm_set1_ps(q.hi)),
+      scale(_mm_set1_ps(q.scale)), step(_mm_set1_ps(q.step)), bias(_mm_set1_ps(q.bias)) {}
+
+  __m128i quantize(__m128 v) const
+  {
+    v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(v, lo), scale), bias));
+  }
+
+  __m128 dequantize(__m128i c) const
+  {
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), step), lo);
+  }
+};
+#endif
+
+}
+
+void quantize_batch(const Quantizer &q, const float *in, uint32_t *out, size_t count)
+{
+  size_t i = 0;
+#ifdef QUANTISATION_AVX2
+  const Lanes8 q8(q);
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), q8.quantize(_mm256_loadu_ps(in + i)));
+#endif
+#ifdef QUANTISATION_SSE2
+  const Lanes4 q4(q);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), q4.quantize(_mm_loadu_ps(in + i)));
+#endif
+  for (; i < count; ++i)
+    out[i] = q.quantize(in[i]);
+}
+
+void dequantize_batch(const Quantizer &q, const uint32_t *in, float *out, size_t count)
+{
+  size_t i = 0;
+#ifdef QUANTISATION_AVX2
+  const Lanes8 q8(q);
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(out + i, q8.dequantize(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i))));
+#endif
+#ifdef QUANTISATION_SSE2
+  const Lanes4 q4(q);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(out + i, q4.dequantize(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+#endif
+  for (; i < count; ++i)
+    out[i] = q.dequantize(in[i]);
+}
+
+void pack_vec3_batch(const float *v1, const Quantizer &q1,
+                     const float *v2, const Quantizer &q2,
+                     const float *v3, const Quantizer &q3,
+                     uint32_t *out, size_t count)
+{
+  assert(q1.numBits + q2.numBits + q3.numBits <= 32);
+  const int shift2 = q1.numBits;
+  const int shift3 = q1.numBits + q2.numBits;
+  size_t i = 0;
+#ifdef QUANTISATION_AVX2
+  {
+    const Lanes8 a(q1), b(q2), c(q3);
+    const __m128i s2 = _mm_cvtsi32_si128(shift2);
+    const __m128i s3 = _mm_cvtsi32_si128(shift3);
+    for (; i + 8 <= count; i += 8)
+    {
+      const __m256i packed = _mm256_or_si256(a.quantize(_mm256_loadu_ps(v1 + i)),
+                             _mm256_or_si256(_mm256_sll_epi32(b.quantize(_mm256_loadu_ps(v2 + i)), s2),
+                                             _mm256_sll_epi32(c.quantize(_mm256_loadu_ps(v3 + i)), s3)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+  }
+#endif
+#ifdef QUANTISATION_SSE2
+  {
+    const Lanes4 a(q1), b(q2), c(q3);
+    const __m128i s2 = _mm_cvtsi32_si128(shift2);
+    const __m128i s3 = _mm_cvtsi32_si128(shift3);
+    for (; i + 4 <= count; i += 4)
+    {
+      const __m128i packed = _mm_or_si128(a.quantize(_mm_loadu_ps(v1 + i)),
+                             _mm_or_si128(_mm_sll_epi32(b.quantize(_mm_loadu_ps(v2 + i)), s2),
+                                          _mm_sll_epi32(c.quantize(_mm_loadu_ps(v3 + i)), s3)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+  }
+#endif
+  for (; i < count; ++i)
+    out[i] = q1.quantize(v1[i]) | (q2.quantize(v2[i]) << shift2) | (q3.quantize(v3[i]) << shift3);
+}
+
+void unpack_vec3_batch(const uint32_t *in, size_t count,
+                       const Quantizer &q1, float *v1,
+                       const Quantizer &q2, float *v2,
+                       const Quantizer &q3, float *v3)
+{
+  assert(q1.numBits + q2.numBits + q3.numBits <= 32);
+  const int shift2 = q1.numBits;
+  const int shift3 = q1.numBits + q2.numBits;
+  size_t i = 0;
+#ifdef QUANTISATION_AVX2
+  {
+    const Lanes8 a(q1), b(q2), c(q3);
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(q1.mask()));
+    const __m256i m2 = _mm256_set1_epi32(static_cast<int>(q2.mask()));
+    const __m256i m3 = _mm256_set1_epi32(static_cast<int>(q3.mask()));
+    const __m128i s2 = _mm_cvtsi32_si128(shift2);
+    const __m128i s3 = _mm_cvtsi32_si128(shift3);
+    for (; i + 8 <= count; i += 8)
+    {
+      const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+      _mm256_storeu_ps(v1 + i, a.dequantize(_mm256_and_si256(packed, m1)));
+      _mm256_storeu_ps(v2 + i, b.dequantize(_mm256_and_si256(_mm256_srl_epi32(packed, s2), m2)));
+      _mm256_storeu_ps(v3 + i, c.dequantize(_mm256_and_si256(_mm256_srl_epi32(packed, s3), m3)));
+    }
+  }
+#endif
+#ifdef QUANTISATION_SSE2
+  {
+    const Lanes4 a(q1), b(q2), c(q3);
+    const __m128i m1 = _mm_set1_epi32(static_cast<int>(q1.mask()));
+    const __m128i m2 = _mm_set1_epi32(static_cast<int>(q2.mask()));
+    const __m128i m3 = _mm_set1_epi32(static_cast<int>(q3.mask()));
+    const __m128i s2 = _mm_cvtsi32_si128(shift2);
+    const __m128i s3 = _mm_cvtsi32_si128(shift3);
+    for (; i + 4 <= count; i += 4)
+    {
+      const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+      _mm_storeu_ps(v1 + i, a.dequantize(_mm_and_si128(packed, m1)));
+      _mm_storeu_ps(v2 + i, b.dequantize(_mm_and_si128(_mm_srl_epi32(packed, s2), m2)));
+      _mm_storeu_ps(v3 + i, c.dequantize(_mm_and_si128(_mm_srl_epi32(packed, s3), m3)));
+    }
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    v1[i] = q1.dequantize(in[i] & q1.mask());
+    v2[i] = q2.dequantize((in[i] >> shift2) & q2.mask());
+    v3[i] = q3.dequantize((in[i] >> shift3) & q3.mask());
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "quantisation.h"
+
+// Квантование целых столбцов SoA за один проход: AVX2 по 8, SSE2 по 4 значения, хвост и прочие платформы - скалярно.
+// Каждое значение проходит те же операции в том же порядке, что и Quantizer::quantize/dequantize,
+// поэтому результат бит в бит совпадает с поэлементным путем на любом наборе инструкций
+
+void quantize_batch(const Quantizer &q, const float *in, uint32_t *out, size_t count);
+void dequantize_batch(const Quantizer &q, const uint32_t *in, float *out, size_t count);
+
+// Слова в формате QuantizedVec3: v1 в младших битах, затем v2 и v3
+void pack_vec3_batch(const float *v1, const Quantizer &q1,
+                     const float *v2, const Quantizer &q2,
+                     const float *v3, const Quantizer &q3,
+                     uint32_t *out, size_t count);
+void unpack_vec3_batch(const uint32_t *in, size_t count,
+                       const Quantizer &q1, float *v1,
+                       const Quantizer &q2, float *v2,
+                       const Quantizer &q3, float *v3);
+
+template<typename Vec3>
+void pack_vec3_batch(const float *v1, const float *v2, const float *v3, uint32_t *out, size_t count)
+{
+  static_assert(std::is_same_v<typename Vec3::Storage, uint32_t>, "Batch kernels produce 32-bit words");
+  pack_vec3_batch(v1, Vec3::Field1::QUANTIZER, v2, Vec3::Field2::QUANTIZER, v3, Vec3::Field3::QUANTIZER, out, count);
+}
+
+template<typename Vec3>
+void unpack_vec3_batch(const uint32_t *in, size_t count, float *v1, float *v2, float *v3)
+{
+  static_assert(std::is_same_v<typename Vec3::Storage, uint32_t>, "Batch kernels produce 32-bit words");
+  unpack_vec3_batch(in, count, Vec3::Field1::QUANTIZER, v1, Vec3::Field2::QUANTIZER, v2, Vec3::Field3::QUANTIZER, v3);
+}
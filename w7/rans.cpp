@@ -0,0 +1,129 @@
+#include "rans.h"
+#include <cstring>
+
+// Нижняя граница нормализованного состояния: после каждого символа состояние в [RANS_L, RANS_L * 256)
+static constexpr uint32_t RANS_L = 1u << 23;
+
+void rans_normalize_frequencies(const uint64_t counts[256], uint16_t freqs[256])
+{
+  uint64_t total = 0;
+  for (int s = 0; s < 256; ++s)
+    total += counts[s];
+  uint32_t sum = 0;
+  for (int s = 0; s < 256; ++s)
+  {
+    const uint64_t scaled = total > 0 ? (counts[s] * RANS_PROB_SCALE + total / 2) / total : RANS_PROB_SCALE / 256;
+    freqs[s] = static_cast<uint16_t>(scaled > 0 ? scaled : 1);
+    sum += freqs[s];
+  }
+  // после округления и минимума в 1 сумма может уйти от RANS_PROB_SCALE: поправка за счет самых частых байтов,
+  // у них относительная ошибка меньше всего
+  while (sum != RANS_PROB_SCALE)
+  {
+    int best = 0;
+    for (int s = 1; s < 256; ++s)
+      if (freqs[s] > freqs[best])
+        best = s;
+    if (sum > RANS_PROB_SCALE)
+    {
+      --freqs[best];
+      --sum;
+    }
+    else
+    {
+      ++freqs[best];
+      ++sum;
+    }
+  }
+}
+
+void rans_init_model(RansModel &model, const uint16_t freqs[256])
+{
+  uint32_t start = 0;
+  for (int s = 0; s < 256; ++s)
+  {
+    const uint32_t freq = freqs[s];
+    RansModel::EncSymbol &enc = model.enc[s];
+    enc.xMax = ((RANS_L >> RANS_PROB_BITS) << 8) * freq;
+    enc.cmplFreq = static_cast<uint16_t>(RANS_PROB_SCALE - freq);
+    // деление x / freq заменяется умножением на обратное и сдвигом, точным для всех x < 2^32
+    if (freq < 2)
+    {
+      enc.rcpFreq = ~0u;
+      enc.rcpShift = 0;
+      enc.bias = start + RANS_PROB_SCALE - 1;
+    }
+    else
+    {
+      uint32_t shift = 0;
+      while (freq > (1u << shift))
+        ++shift;
+      enc.rcpFreq = static_cast<uint32_t>(((uint64_t(1) << (shift + 31)) + freq - 1) / freq);
+      enc.rcpShift = static_cast<uint16_t>(shift - 1);
+      enc.bias = start;
+    }
+    enc.rcpShift += 32;
+
+    model.dec[s].start = static_cast<uint16_t>(start);
+    model.dec[s].freq = static_cast<uint16_t>(freq);
+    memset(&model.slotSymbol[start], s, freq);
+    start += freq;
+  }
+}
+
+size_t rans_encode(const RansModel &model, const uint8_t *in, size_t size, uint8_t *out, size_t capacity)
+{
+  // rANS работает как стек: символы кодируются с конца, байты пишутся с конца буфера к началу
+  uint8_t *end = out + capacity;
+  uint8_t *ptr = end;
+  uint32_t x = RANS_L;
+  for (size_t i = size; i > 0; --i)
+  {
+    const RansModel::EncSymbol &sym = model.enc[in[i - 1]];
+    while (x >= sym.xMax)
+    {
+      if (ptr == out + RANS_STATE_SIZE)
+        return 0;
+      *--ptr = static_cast<uint8_t>(x);
+      x >>= 8;
+    }
+    const uint32_t q = static_cast<uint32_t>((uint64_t(x) * sym.rcpFreq) >> sym.rcpShift);
+    x += sym.bias + q * sym.cmplFreq;
+  }
+  if (ptr - out < static_cast<ptrdiff_t>(RANS_STATE_SIZE))
+    return 0;
+  ptr -= RANS_STATE_SIZE;
+  for (size_t b = 0; b < RANS_STATE_SIZE; ++b)
+    ptr[b] = static_cast<uint8_t>(x >> (8 * b));
+
+  const size_t encoded = static_cast<size_t>(end - ptr);
+  memmove(out, ptr, encoded);
+  return encoded;
+}
+
+bool rans_decode(const RansModel &model, const uint8_t *in, size_t size, uint8_t *out, size_t outSize)
+{
+  if (size < RANS_STATE_SIZE)
+    return false;
+  const uint8_t *end = in + size;
+  uint32_t x = 0;
+  for (size_t b = 0; b < RANS_STATE_SIZE; ++b)
+    x |= uint32_t(in[b]) << (8 * b);
+  const uint8_t *ptr = in + RANS_STATE_SIZE;
+
+  for (size_t i = 0; i < outSize; ++i)
+  {
+    const uint32_t slot = x & (RANS_PROB_SCALE - 1);
+    const uint8_t s = model.slotSymbol[slot];
+    out[i] = s;
+    x = model.dec[s].freq * (x >> RANS_PROB_BITS) + slot - model.dec[s].start;
+    while (x < RANS_L)
+    {
+      if (ptr == end)
+        return false;
+      x = (x << 8) | *ptr++;
+    }
+  }
+  // кодер начинал с RANS_L: другое конечное состояние или лишние байты - поврежденный вход
+  return x == RANS_L && ptr == end;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Энтропийное кодирование байтов rANS со статической моделью нулевого порядка: вероятность каждого байта
+// фиксирована заранее (обучена на записанном трафике), поэтому таблицы не передаются и не подстраиваются.
+// Состояние 32 бита, нормализация побайтово; кодер делит через заранее посчитанные обратные частоты,
+// декодер находит символ по таблице слотов одним обращением
+
+constexpr uint32_t RANS_PROB_BITS = 12;
+constexpr uint32_t RANS_PROB_SCALE = 1u << RANS_PROB_BITS;
+// 4 байта финального состояния
+constexpr size_t RANS_STATE_SIZE = sizeof(uint32_t);
+
+struct RansModel
+{
+  struct EncSymbol
+  {
+    uint32_t xMax;     // при состоянии не меньше этого сначала выдвигаются байты
+    uint32_t rcpFreq;  // ceil(2^(shift + 31) / freq)
+    uint32_t bias;
+    uint16_t cmplFreq; // RANS_PROB_SCALE - freq
+    uint16_t rcpShift;
+  };
+
+  struct DecSymbol
+  {
+    uint16_t start;
+    uint16_t freq;
+  };
+
+  std::array<EncSymbol, 256> enc;
+  std::array<DecSymbol, 256> dec;
+  std::array<uint8_t, RANS_PROB_SCALE> slotSymbol;
+};
+
+// counts - сколько раз встретился каждый байт. Частоты масштабируются к сумме RANS_PROB_SCALE,
+// каждому байту не меньше 1, чтобы кодировались и не встречавшиеся при обучении
+void rans_normalize_frequencies(const uint64_t counts[256], uint16_t freqs[256]);
+// freqs в сумме дают RANS_PROB_SCALE
+void rans_init_model(RansModel &model, const uint16_t freqs[256]);
+
+// Граница размера закодированных данных для size байт: не меньше этого буфера out гарантированно хватит
+constexpr size_t rans_encode_bound(size_t size) { return size + size / 2 + RANS_STATE_SIZE + 16; }
+
+// Возвращает размер закодированного или 0, если он не поместился в capacity
+size_t rans_encode(const RansModel &model, const uint8_t *in, size_t size, uint8_t *out, size_t capacity);
+// outSize - размер исходных данных, его передает вызывающий. false, если вход поврежден или кончился
+bool rans_decode(const RansModel &model, const uint8_t *in, size_t size, uint8_t *out, size_t outSize);
@@ -2,13 +2,20 @@
 #include <iostream>
 #include "entity.h"
 #include "protocol.h"
+#include "netStats.h"
+#include "packetCapture.h"
 #include "mathUtils.h"
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 static std::vector<Entity> entities;
 static std::map<uint16_t, ENetPeer*> controlledMap;
+static std::map<ENetPeer*, uint16_t> peerEntityMap;
+static SnapshotTransforms snapshotTransforms;
+static std::vector<SnapshotPrecision> snapshotPrecisions;
 
 void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
 {
@@ -31,6 +38,7 @@ void on_join(ENetPacket *packet, ENetPeer *peer, ENetHost *host)
   entities.push_back(ent);
 
   controlledMap[newEid] = peer;
+  peerEntityMap[peer] = newEid;
 
 
   // send info about new entity to everyone
@@ -44,7 +52,8 @@ void on_input(ENetPacket *packet)
 {
   uint16_t eid = invalid_entity;
   float thr = 0.f; float steer = 0.f;
-  deserialize_entity_input(packet, eid, thr, steer);
+  if (!deserialize_entity_input(packet, eid, thr, steer))
+    return;
   for (Entity &e : entities)
     if (e.eid == eid)
     {
@@ -55,6 +64,27 @@ void on_input(ENetPacket *packet)
 
 int main(int argc, const char **argv)
 {
+  // --record-snapshots <file>: писать снепшоты до сжатия, на них обучается модель w7_snapshot_model
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--record-snapshots") == 0)
+    {
+      if (!record_snapshot_payloads(argv[i + 1]))
+      {
+        printf("Cannot open snapshot capture %s\n", argv[i + 1]);
+        return 1;
+      }
+      printf("Recording snapshots to %s\n", argv[i + 1]);
+    }
+  }
+
+  NetStatsReporter netStats(message_type_name);
+  if (!netStats.openFromArgs(argc, argv))
+    return 1;
+  // --capture-packets <каталог>: отправленные пакеты - затравочный корпус для w7_fuzz
+  if (!packet_capture_open_from_args(argc, argv, message_type_name))
+    return 1;
+
   if (enet_initialize() != 0)
   {
     printf("Cannot init ENet");
@@ -88,6 +118,7 @@ int main(int argc, const char **argv)
         printf("Connection with %x:%u established\n", event.peer->address.host, event.peer->address.port);
         break;
       case ENET_EVENT_TYPE_RECEIVE:
+        net_stats_packet(E_NET_STATS_RECEIVED, event.peer, event.packet);
         switch (get_packet_type(event.packet))
         {
           case E_CLIENT_TO_SERVER_JOIN:
@@ -105,18 +136,44 @@ int main(int argc, const char **argv)
     }
     static int t = 0;
     for (Entity &e : entities)
-    {
-      // simulate
       simulate_entity(e, dt);
-      // send
-      for (size_t i = 0; i < server->connectedPeers; ++i)
+
+    // квантование один раз на тик для всех пиров, столбцами
+    const size_t n = entities.size();
+    snapshotTransforms.resize(n);
+    snapshotPrecisions.resize(n);
+    for (size_t j = 0; j < n; ++j)
+    {
+      snapshotTransforms.eids[j] = entities[j].eid;
+      snapshotTransforms.x[j] = entities[j].x;
+      snapshotTransforms.y[j] = entities[j].y;
+      snapshotTransforms.ori[j] = entities[j].ori;
+    }
+    snapshotTransforms.pack();
+
+    // send
+    for (size_t i = 0; i < server->connectedPeers; ++i)
+    {
+      ENetPeer *peer = &server->peers[i];
+      auto viewer = peerEntityMap.find(peer);
+      const Entity *viewerEntity = nullptr;
+      if (viewer != peerEntityMap.end())
+        for (const Entity &e : entities)
+          if (e.eid == viewer->second)
+            viewerEntity = &e;
+      int16_t anchorCellX = 0;
+      int16_t anchorCellY = 0;
+      if (viewerEntity)
       {
-        ENetPeer *peer = &server->peers[i];
-        // skip this here in this implementation
-        //if (controlledMap[e.eid] != peer)
-        send_snapshot(peer, e.eid, e.x, e.y, e.ori);
+        choose_snapshot_precision(snapshotTransforms, viewerEntity->x, viewerEntity->y, snapshotPrecisions.data());
+        anchorCellX = snapshot_cell(viewerEntity->x);
+        anchorCellY = snapshot_cell(viewerEntity->y);
       }
+      else
+        std::fill(snapshotPrecisions.begin(), snapshotPrecisions.end(), E_PRECISION_FULL);
+      send_snapshot(peer, snapshotTransforms, snapshotPrecisions.data(), anchorCellX, anchorCellY);
     }
+    netStats.update(curTime);
     usleep(10000);
   }
 
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Сгенерировано w7_snapshot_model train по cap_train.bin: 4500 снепшотов, 1658692 байт.
+// Частоты байтов полезного груза снепшотов, в сумме RANS_PROB_SCALE
+constexpr uint16_t SNAPSHOT_BYTE_FREQUENCIES[256] = {
+   672,  88,  29,  51,   6, 730,  21,  38,   4,   1,   3,  21,  10,   7,  15,  34,
+     4,   2,   3,   2,   4,   1,  17,  21,  12,   5,   4,  10,  13,   3,  18,  25,
+    14,   3,   5,   4,   3,   2,   5,   6,  11,   6,   3,   3,  12,   5,  13,  14,
+    22,   5,   6,   5,  11,  10,   5,   7,  13,   4,   5,   5,   5,   5,  12,  12,
+    46,   2,   2,   6,   3,   4,   8,   4,   7,   3,   7,  16,   4,   4,   3,   3,
+     7,   2,   4,   5,   5,   4,   2,   2,  14,   7,   8,   8,   4,   6,   4,   9,
+    19,   3,   9,   4,   2,   7,   6,   3,   7,   8,   4,   4,   5,   9,   7,  13,
+    25,   8,   8,   6,   7,   6,   5,   6,   5,   7,  10,  12,   8,   7,   7,  41,
+    72,  14,   5,   1,   1,   2,   9,   4,   5,   6,   3,   4,   9,   5,   2,   2,
+    14,   2,   4,   5,   7,   2,   6,  15,   7,   5,   7,   3,  13,   3,   3,   8,
+    28,   2,   8,   6,   6,   4,   8,   9,   9,   5,   6,   5,   7,   9,   4,   3,
+    21,   3,   3,   4,  10,   9,   9,   9,   7,   8,   8,  10,   7,   4,   7,  27,
+    43,   3,   1,   3,   4,   6,   3,   5,   6,   8,   4,   5,  10,  16,   6,   6,
+    10,   7,  13,   5,  19,   5,   8,   5,  13,   9,   9,   6,   7,  19,   9,  17,
+    14,   3,   5,  15,  10,  12,  14,  11,  12,  11,   8,   6,   6,  14,   7,  11,
+     9,   6,  16,   9,   5,   4,  11,  21,  19,  16,  21,  22,  23,  34,  37, 275,
+};
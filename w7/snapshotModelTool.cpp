@@ -0,0 +1,166 @@
+// Статическая модель для сжатия снепшотов rANS.
+// Использование:
+//   w7_snapshot_model train <capture> <snapshotModel.h>  посчитать частоты байтов записи и сгенерировать заголовок
+//   w7_snapshot_model bench <capture> [--repeat N]       размер и скорость кодирования/декодирования записи
+// Запись делает сервер: w7_server --record-snapshots <capture>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "rans.h"
+#include "snapshotModel.h"
+
+typedef std::vector<uint8_t> Payload;
+
+static bool read_capture(const char *path, std::vector<Payload> &payloads)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  uint32_t size;
+  while (fread(&size, sizeof(size), 1, f) == 1)
+  {
+    Payload payload(size);
+    if (fread(payload.data(), 1, size, f) != size)
+      break;
+    payloads.push_back(std::move(payload));
+  }
+  fclose(f);
+  return true;
+}
+
+static void count_bytes(const std::vector<Payload> &payloads, uint64_t counts[256])
+{
+  std::fill(counts, counts + 256, 0);
+  for (const Payload &payload : payloads)
+    for (uint8_t b : payload)
+      ++counts[b];
+}
+
+static int train(const std::vector<Payload> &payloads, const char *capturePath, const char *outPath)
+{
+  uint64_t counts[256];
+  count_bytes(payloads, counts);
+  uint16_t freqs[256];
+  rans_normalize_frequencies(counts, freqs);
+
+  FILE *f = fopen(outPath, "w");
+  if (!f)
+  {
+    printf("Cannot write %s\n", outPath);
+    return 1;
+  }
+  size_t bytes = 0;
+  for (const Payload &payload : payloads)
+    bytes += payload.size();
+  fprintf(f, "#pragma once\n#include <cstdint>\n\n");
+  fprintf(f, "// Сгенерировано w7_snapshot_model train по %s: %zu снепшотов, %zu байт.\n", capturePath, payloads.size(), bytes);
+  fprintf(f, "// Частоты байтов полезного груза снепшотов, в сумме RANS_PROB_SCALE\n");
+  fprintf(f, "constexpr uint16_t SNAPSHOT_BYTE_FREQUENCIES[256] = {\n");
+  for (int s = 0; s < 256; ++s)
+    fprintf(f, "%s%4u,%s", s % 16 == 0 ? "  " : "", freqs[s], s % 16 == 15 ? "\n" : "");
+  fprintf(f, "};\n");
+  fclose(f);
+  printf("%zu snapshots, %zu bytes -> %s\n", payloads.size(), bytes, outPath);
+  return 0;
+}
+
+struct BenchResult
+{
+  size_t rawBytes = 0;
+  size_t codedBytes = 0;  // как в протоколе: сжатый пакет только если он меньше исходного
+  size_t compressed = 0;  // сколько пакетов ушло бы сжатыми
+  double encodeSeconds = 0.0;
+  double decodeSeconds = 0.0;
+  bool roundTrip = true;
+};
+
+static BenchResult bench(const RansModel &model, const std::vector<Payload> &payloads, int repeat)
+{
+  BenchResult result;
+  std::vector<std::vector<uint8_t>> coded(payloads.size());
+  std::vector<size_t> codedSizes(payloads.size());
+  for (size_t i = 0; i < payloads.size(); ++i)
+    coded[i].resize(rans_encode_bound(payloads[i].size()));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; ++r)
+    for (size_t i = 0; i < payloads.size(); ++i)
+      codedSizes[i] = rans_encode(model, payloads[i].data(), payloads[i].size(), coded[i].data(), coded[i].size());
+  result.encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  Payload decoded;
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; ++r)
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+      decoded.resize(payloads[i].size());
+      result.roundTrip &= rans_decode(model, coded[i].data(), codedSizes[i], decoded.data(), decoded.size());
+    }
+  result.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t i = 0; i < payloads.size(); ++i)
+  {
+    decoded.resize(payloads[i].size());
+    result.roundTrip &= rans_decode(model, coded[i].data(), codedSizes[i], decoded.data(), decoded.size()) &&
+                        decoded == payloads[i];
+    // + байт длины исходного (varint), его протокол пишет перед сжатым
+    const size_t withSize = codedSizes[i] + (payloads[i].size() < 128 ? 1 : 2);
+    result.rawBytes += payloads[i].size();
+    result.codedBytes += std::min(withSize, payloads[i].size());
+    result.compressed += withSize < payloads[i].size() ? 1 : 0;
+  }
+  return result;
+}
+
+static void print_bench(const char *name, const BenchResult &result, size_t packets, int repeat)
+{
+  const double mb = double(result.rawBytes) * repeat / (1024.0 * 1024.0);
+  printf("%-10s %zu -> %zu bytes (%.1f%%), %zu/%zu packets compressed, encode %.0f MB/s, decode %.0f MB/s%s\n",
+         name, result.rawBytes, result.codedBytes, 100.0 * result.codedBytes / std::max<size_t>(result.rawBytes, 1),
+         result.compressed, packets, mb / result.encodeSeconds, mb / result.decodeSeconds,
+         result.roundTrip ? "" : ", ROUND TRIP FAILED");
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc < 3 || (strcmp(argv[1], "train") == 0 && argc < 4))
+  {
+    printf("Usage: %s train <capture> <snapshotModel.h>\n", argv[0]);
+    printf("       %s bench <capture> [--repeat N]\n", argv[0]);
+    return 1;
+  }
+  std::vector<Payload> payloads;
+  if (!read_capture(argv[2], payloads))
+  {
+    printf("Cannot read capture %s\n", argv[2]);
+    return 1;
+  }
+
+  if (strcmp(argv[1], "train") == 0)
+    return train(payloads, argv[2], argv[3]);
+
+  int repeat = 1;
+  for (int i = 3; i < argc; ++i)
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::max(atoi(argv[++i]), 1);
+
+  // встроенная модель против обученной на этой же записи - верхняя граница того, что даст переобучение
+  RansModel builtin;
+  rans_init_model(builtin, SNAPSHOT_BYTE_FREQUENCIES);
+  uint64_t counts[256];
+  count_bytes(payloads, counts);
+  uint16_t freqs[256];
+  rans_normalize_frequencies(counts, freqs);
+  RansModel trained;
+  rans_init_model(trained, freqs);
+
+  const BenchResult builtinResult = bench(builtin, payloads, repeat);
+  const BenchResult trainedResult = bench(trained, payloads, repeat);
+  print_bench("built-in", builtinResult, payloads.size(), repeat);
+  print_bench("trained", trainedResult, payloads.size(), repeat);
+  return builtinResult.roundTrip && trainedResult.roundTrip ? 0 : 2;
+}
@@ -0,0 +1,71 @@
+#include "varint.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VARINT_SSE2 1
+#endif
+
+#ifdef VARINT_SSE2
+// 16 однобайтовых чисел из bytes (уже сдвинутых на бит длины) в 16 uint64
+static void store_bytes_as_u64(__m128i bytes, uint64_t *out)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+  for (int w = 0; w < 2; ++w)
+  {
+    const __m128i dwords[2] = {_mm_unpacklo_epi16(words[w], zero), _mm_unpackhi_epi16(words[w], zero)};
+    for (int d = 0; d < 2; ++d)
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi32(dwords[d], zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2), _mm_unpackhi_epi32(dwords[d], zero));
+      out += 4;
+    }
+  }
+}
+#endif
+
+size_t varint_decode_batch(const uint8_t *in, size_t size, uint64_t *out, size_t count)
+{
+  size_t pos = 0;
+  size_t i = 0;
+#ifdef VARINT_SSE2
+  while (count - i >= 16 && size - pos >= 16)
+  {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+    // младший бит каждого байта в старший: единица - однобайтовое число
+    const uint32_t singles = static_cast<uint32_t>(_mm_movemask_epi8(_mm_slli_epi64(bytes, 7)));
+    if (singles == 0xffff)
+    {
+      store_bytes_as_u64(_mm_and_si128(_mm_srli_epi64(bytes, 1), _mm_set1_epi8(0x7f)), out + i);
+      pos += 16;
+      i += 16;
+      continue;
+    }
+    // однобайтовые числа до первого длинного, затем длинное обычным путем
+    const uint32_t run = static_cast<uint32_t>(std::countr_zero(~singles));
+    for (uint32_t k = 0; k < run; ++k)
+      out[i + k] = in[pos + k] >> 1;
+    pos += run;
+    i += run;
+    if (size - pos < VARINT_MAX_SIZE)
+      break;
+    pos += varint_decode_unchecked(in + pos, out[i++]);
+  }
+#endif
+  for (; i < count && size - pos >= VARINT_MAX_SIZE; ++i)
+    pos += varint_decode_unchecked(in + pos, out[i]);
+  for (; i < count; ++i)
+  {
+    const uint32_t n = varint_decode(in + pos, size - pos, out[i]);
+    if (n == 0)
+      return 0;
+    pos += n;
+  }
+  return pos;
+}
+
+void zigzag_decode_batch(const uint64_t *in, int64_t *out, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    out[i] = zigzag_decode(in[i]);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Целые переменной длины с длиной в префиксе: число младших нулевых бит первого байта до первой единицы
+// плюс один - это длина в байтах n от 1 до 8, остальные 8n - n бит - значение (little-endian).
+// Первый байт 0 - 9-байтный вид, за ним 64-битное значение целиком.
+// Длина известна по первому байту, поэтому декодирование - одна загрузка 8 байт, countr_zero и сдвиг без цикла по байтам.
+// Знаковые значения (разности тиков, идентификаторов, координат) сначала проходят zigzag: 0, -1, 1, -2 -> 0, 1, 2, 3
+
+constexpr uint32_t VARINT_MAX_SIZE = 9;
+
+constexpr uint64_t zigzag_encode(int64_t v)
+{
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+constexpr int64_t zigzag_decode(uint64_t v)
+{
+  return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+constexpr uint32_t varint_size(uint64_t v)
+{
+  const int bits = 64 - std::countl_zero(v | 1);
+  return bits > 56 ? 9 : static_cast<uint32_t>(bits + 6) / 7;
+}
+
+inline uint64_t varint_load_le64(const uint8_t *in)
+{
+  uint64_t v;
+  memcpy(&v, in, sizeof(v));
+  if constexpr (std::endian::native == std::endian::big)
+  {
+    uint64_t swapped = 0;
+    for (int i = 0; i < 8; ++i)
+      swapped |= ((v >> (8 * i)) & 0xff) << (56 - 8 * i);
+    v = swapped;
+  }
+  return v;
+}
+
+inline void varint_store_le64(uint8_t *out, uint64_t v)
+{
+  for (int i = 0; i < 8; ++i)
+    out[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+// out должен вмещать VARINT_MAX_SIZE байт, даже если число короче. Возвращает длину
+inline uint32_t varint_encode(uint64_t v, uint8_t *out)
+{
+  const uint32_t n = varint_size(v);
+  if (n == 9)
+  {
+    out[0] = 0;
+    varint_store_le64(out + 1, v);
+    return 9;
+  }
+  varint_store_le64(out, ((v << 1) | 1) << (n - 1));
+  return n;
+}
+
+// Без проверки границ: после in должно быть не меньше VARINT_MAX_SIZE байт
+inline uint32_t varint_decode_unchecked(const uint8_t *in, uint64_t &value)
+{
+  const uint32_t n = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(in[0]) | 0x100)) + 1;
+  if (n == 9)
+  {
+    value = varint_load_le64(in + 1);
+    return 9;
+  }
+  value = (varint_load_le64(in) >> n) & ((uint64_t(1) << (7 * n)) - 1);
+  return n;
+}
+
+// С проверкой границ. 0, если число не помещается в size байт
+inline uint32_t varint_decode(const uint8_t *in, size_t size, uint64_t &value)
+{
+  if (size >= VARINT_MAX_SIZE)
+    return varint_decode_unchecked(in, value);
+  if (size == 0)
+    return 0;
+  uint8_t padded[VARINT_MAX_SIZE] = {};
+  memcpy(padded, in, size);
+  const uint32_t n = varint_decode_unchecked(padded, value);
+  return n <= size ? n : 0;
+}
+
+// Декодирует count чисел подряд. На SSE2 отрезки однобайтовых чисел (малые разности - самый частый случай)
+// разбираются по 16 за раз. Возвращает число прочитанных байт, 0 - если данные кончились раньше
+size_t varint_decode_batch(const uint8_t *in, size_t size, uint64_t *out, size_t count);
+
+void zigzag_decode_batch(const uint64_t *in, int64_t *out, size_t count);